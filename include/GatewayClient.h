@@ -2,7 +2,9 @@
 
 #include "Common.h"
 #include "GatewayClientState.h"
+#include "GatewayLinkQuality.h"
 #include "span.h"
+#include "TinyVec.h"
 
 #include <WebSocketsClient.h>
 
@@ -21,6 +23,7 @@ namespace OpenShock {
     ~GatewayClient();
 
     inline GatewayClientState state() const { return m_state; }
+    inline const GatewayLinkQuality& linkQuality() const { return m_linkQuality.stats(); }
 
     void connect(const std::string& host, uint16_t port, const std::string& path);
     void disconnect();
@@ -33,9 +36,20 @@ namespace OpenShock {
   private:
     void _setState(GatewayClientState state);
     void _sendBootStatus();
+    void _sendLinkProbe();
     void _handleEvent(WStype_t type, uint8_t* payload, std::size_t length);
+    void _handleFragment(WStype_t type, const uint8_t* payload, std::size_t length);
+
+    enum class FragmentState : uint8_t {
+      None,
+      Binary,
+      Discarding,
+    };
 
     WebSocketsClient m_webSocket;
     GatewayClientState m_state;
+    GatewayLinkQualityTracker m_linkQuality;
+    FragmentState m_fragmentState;
+    TinyVec<uint8_t> m_fragmentArena;
   };
 }  // namespace OpenShock
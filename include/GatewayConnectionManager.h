@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AccountLinkResultCode.h"
+#include "GatewayLinkQuality.h"
 #include "span.h"
 
 #include <cstdint>
@@ -11,6 +12,7 @@ namespace OpenShock::GatewayConnectionManager {
   [[nodiscard]] bool Init();
 
   bool IsConnected();
+  bool GetLinkQuality(GatewayLinkQuality& out);
 
   bool IsLinked();
   AccountLinkResultCode Link(std::string_view linkCode);
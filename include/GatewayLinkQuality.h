@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+#include <cstdint>
+
+namespace OpenShock {
+  struct GatewayLinkQuality {
+    // Upper bounds (exclusive) of the RTT histogram buckets in milliseconds, the last bucket is open-ended
+    static constexpr std::array<uint16_t, 7> RTT_BUCKET_BOUNDS_MS = {25, 50, 100, 200, 400, 800, 1600};
+    static constexpr std::size_t RTT_BUCKET_COUNT                  = RTT_BUCKET_BOUNDS_MS.size() + 1;
+
+    uint32_t rttEwmaUs;
+    uint32_t rttJitterUs;
+    uint32_t probesSent;
+    uint32_t probesLost;
+    std::array<uint16_t, RTT_BUCKET_COUNT> rttHistogram;
+  };
+
+  /// @brief Tracks round-trip times of hub-initiated WebSocket ping probes to the LCG
+  class GatewayLinkQualityTracker {
+    DISABLE_COPY(GatewayLinkQualityTracker);
+    DISABLE_MOVE(GatewayLinkQualityTracker);
+
+  public:
+    GatewayLinkQualityTracker();
+
+    /// @brief Returns true if a new probe should be sent, either because none is outstanding or the outstanding one timed out
+    bool shouldProbe(int64_t nowUs);
+    /// @brief Registers a sent probe and returns the echo ID to embed in its payload
+    uint32_t onProbeSent(int64_t nowUs);
+    /// @brief Registers a probe response, ignoring responses to stale or unknown probes
+    void onProbeAnswered(uint32_t echoId, int64_t nowUs);
+    void reset();
+
+    const GatewayLinkQuality& stats() const { return m_stats; }
+
+  private:
+    void addSample(uint32_t rttUs);
+
+    GatewayLinkQuality m_stats;
+    int64_t m_probeSentAtUs;
+    uint32_t m_probeEchoId;
+    bool m_probeOutstanding;
+  };
+}  // namespace OpenShock
@@ -3,6 +3,7 @@
 #include "FirmwareBootType.h"
 #include "OtaUpdateChannel.h"
 #include "SemVer.h"
+#include "util/PartitionUtils.h"
 
 #include <array>
 #include <string>
@@ -15,8 +16,13 @@ namespace OpenShock::OtaUpdateManager {
   struct FirmwareRelease {
     std::string appBinaryUrl;
     uint8_t appBinaryHash[32];
+    OpenShock::PartitionCompression appBinaryCompression;
+    std::string appBinaryDeltaUrl;  // Patch from the running version, empty if none is published
+    OpenShock::PartitionCompression appBinaryDeltaCompression;
     std::string filesystemBinaryUrl;
     uint8_t filesystemBinaryHash[32];
+    OpenShock::PartitionCompression filesystemBinaryCompression;
+    std::string filesystemBlockHashesUrl;  // Per-block hashes of the uncompressed image, empty if none are published
   };
 
   bool TryGetFirmwareVersion(OtaUpdateChannel channel, OpenShock::SemVer& version);
@@ -3,11 +3,14 @@
 #include "Common.h"
 #include "SimpleMutex.h"
 
+#include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <vector>
 
 namespace OpenShock {
+  /// @brief Sliding-window request limiter, a request is allowed if every window holds fewer than its count of earlier requests
+  ///
+  /// Only the most recent accepted requests are kept, as many as the largest count, so checking is O(limits) with fixed memory.
   class RateLimiter {
     DISABLE_COPY(RateLimiter);
     DISABLE_MOVE(RateLimiter);
@@ -30,10 +33,13 @@ namespace OpenShock {
       uint16_t count;
     };
 
+    void resetRequests();
+
     OpenShock::SimpleMutex m_mutex;
     int64_t m_nextSlot;
-    int64_t m_nextCleanup;
     std::vector<Limit> m_limits;
-    std::deque<int64_t> m_requests;
+    std::vector<int64_t> m_requests;  // Ring of accepted request times, oldest overwritten first
+    std::size_t m_requestHead;
+    std::size_t m_requestCount;
   };
 }  // namespace OpenShock
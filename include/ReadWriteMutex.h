@@ -1,15 +1,38 @@
 #pragma once
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
 #include <freertos/semphr.h>
 
 #include "Common.h"
 
+#include <atomic>
+#include <cstdint>
+
 namespace OpenShock {
+  /// @brief Reader/writer lock that prefers writers
+  ///
+  /// Uncontended readers only touch an atomic counter. A writer first stops new readers from entering and then waits for the
+  /// ones already inside to leave, so a steady stream of readers can no longer starve it: its wait is bounded by the longest
+  /// read section in progress. Readers that queue up during a write are counted, and the next writer waits until all of them
+  /// got in, so back-to-back writers cannot starve readers either. A reader that arrives just as one writer hands over to
+  /// the next may wait for both.
+  ///
+  /// Not recursive, taking a read lock while holding one deadlocks once a writer is waiting in between.
   class ReadWriteMutex {
     DISABLE_COPY(ReadWriteMutex);
     DISABLE_MOVE(ReadWriteMutex);
 
   public:
+    struct Metrics {
+      uint32_t readContentions;   // Read locks that had to wait for a writer
+      uint32_t writeContentions;  // Write locks that had to wait for another writer or for readers
+      uint32_t timeouts;          // Lock attempts that gave up
+      uint32_t readWaitUs;        // Total time spent waiting for read locks, wraps around
+      uint32_t writeWaitUs;       // Total time spent waiting for write locks, wraps around
+      uint32_t maxWriteWaitUs;    // Longest single wait for a write lock
+    };
+
     ReadWriteMutex();
     ~ReadWriteMutex();
 
@@ -19,10 +42,25 @@ namespace OpenShock {
     bool lockWrite(TickType_t xTicksToWait);
     void unlockWrite();
 
+    Metrics getMetrics() const;
+
   private:
-    SemaphoreHandle_t m_mutex;
-    SemaphoreHandle_t m_readSem;
-    int m_readers;
+    bool tryEnterRead();
+    void leaveWaitingReaders();
+    void recordWait(bool write, int64_t beginUs);
+
+    std::atomic<uint32_t> m_state;  // Number of readers inside, plus WRITER_BIT while a writer holds or is acquiring the lock
+    SemaphoreHandle_t m_writeMutex;
+    SemaphoreHandle_t m_drained;             // Given by the last reader to leave while a writer waits, and by the last queued reader to get in
+    EventGroupHandle_t m_gate;               // Open bit is cleared while readers have to wait
+    std::atomic<uint32_t> m_waitingReaders;  // Readers that found the lock taken by a writer and have not got in yet
+
+    std::atomic<uint32_t> m_readContentions;
+    std::atomic<uint32_t> m_writeContentions;
+    std::atomic<uint32_t> m_timeouts;
+    std::atomic<uint32_t> m_readWaitUs;
+    std::atomic<uint32_t> m_writeWaitUs;
+    std::atomic<uint32_t> m_maxWriteWaitUs;
   };
 
   class ScopedReadLock {
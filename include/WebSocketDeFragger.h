@@ -6,10 +6,11 @@
 #include "WebSocketMessageType.h"
 
 #include <WebSockets.h>
+#include <WebSocketsServer.h>
 
+#include <array>
 #include <cstdint>
 #include <functional>
-#include <map>
 
 namespace OpenShock {
   class WebSocketDeFragger {
@@ -19,9 +20,12 @@ namespace OpenShock {
   public:
     typedef std::function<void(uint8_t socketId, WebSocketMessageType type, tcb::span<const uint8_t> data)> EventCallback;
 
-    WebSocketDeFragger(EventCallback callback);
+    static const uint8_t MAX_SOCKETS = WEBSOCKETS_SERVER_CLIENT_MAX;
+
+    WebSocketDeFragger(EventCallback callback, uint32_t maxMessageSize);
     ~WebSocketDeFragger();
 
+    /// @brief Unfragmented frames are forwarded straight from the socket buffer without being copied into a slot
     void handler(uint8_t socketId, WStype_t type, const uint8_t* payload, std::size_t length);
     void onEvent(const EventCallback& callback);
     void clear(uint8_t socketId);
@@ -32,12 +36,23 @@ namespace OpenShock {
     void append(uint8_t socketId, const uint8_t* data, uint32_t length);
     void finish(uint8_t socketId, const uint8_t* data, uint32_t length);
 
-    struct Message {
+    enum class SlotState : uint8_t {
+      Idle,
+      Receiving,
+      Discarding,
+    };
+
+    // Buffers keep their capacity between messages, so a socket only allocates while its largest message grows
+    struct Slot {
       TinyVec<uint8_t> data;
       WebSocketMessageType type;
+      SlotState state;
     };
 
-    std::map<uint8_t, Message> m_messages;
+    bool appendToSlot(uint8_t socketId, Slot& slot, const uint8_t* data, uint32_t length);
+
+    std::array<Slot, MAX_SOCKETS> m_slots;
+    uint32_t m_maxMessageSize;
     EventCallback m_callback;
   };
 }  // namespace OpenShock
@@ -5,24 +5,67 @@
 #include "config/EStopConfig.h"
 #include "config/OtaUpdateConfig.h"
 #include "config/RFConfig.h"
+#include "config/RootConfig.h"
 #include "config/SerialInputConfig.h"
 #include "config/WiFiConfig.h"
 #include "config/WiFiCredentials.h"
+#include "ReadWriteMutex.h"
 #include "TinyVec.h"
 
 #include <hal/gpio_types.h>
 
 #include <functional>
+#include <memory>
 #include <string_view>
 #include <vector>
 
 namespace OpenShock::Config {
+  /* Top level sections of the config, combined as a bitmask in change events. */
+  constexpr uint8_t SECTION_RF            = 1 << 0;
+  constexpr uint8_t SECTION_WIFI          = 1 << 1;
+  constexpr uint8_t SECTION_CAPTIVEPORTAL = 1 << 2;
+  constexpr uint8_t SECTION_BACKEND       = 1 << 3;
+  constexpr uint8_t SECTION_SERIALINPUT   = 1 << 4;
+  constexpr uint8_t SECTION_OTAUPDATE     = 1 << 5;
+  constexpr uint8_t SECTION_ESTOP         = 1 << 6;
+  constexpr uint8_t SECTION_COUNT         = 7;
+  constexpr uint8_t SECTION_ALL           = (1 << SECTION_COUNT) - 1;
+
+  /* Payload of OPENSHOCK_EVENT_CONFIG_CHANGED, posted after every change to the in-memory config. */
+  struct ChangedEventData {
+    uint8_t sections;     // SECTION_* bits that changed
+    uint32_t generation;  // Value of GetGeneration() right after the change
+  };
+
   void Init();
 
+  /* Incremented on every change, lets consumers that cache config tell whether their copy is current. */
+  uint32_t GetGeneration();
+
+  /* Set* calls only update memory, changed sections are appended to a log once changes stop coming in. Flush writes pending changes right away. */
+  bool Flush();
+
+  struct PersistMetrics {
+    uint32_t writes;         // Log appends and config file rewrites
+    uint32_t writesAvoided;  // Changes folded into a later write
+    uint32_t compactions;    // Config file rewrites
+    uint32_t logBytes;       // Bytes appended to the config log
+  };
+  PersistMetrics GetPersistMetrics();
+
+  /* Wait times and timeouts of the lock guarding the config. */
+  ReadWriteMutex::Metrics GetLockMetrics();
+
+  /* Immutable view of the whole config, lets hot paths read single fields without locking or copying. Hold it only briefly, it pins that version in memory. */
+  std::shared_ptr<const RootConfig> GetSnapshot();
+
   /* GetAsJSON and SaveFromJSON are used for Reading/Writing the config file in its human-readable form. */
   std::string GetAsJSON(bool withSensitiveData);
   bool SaveFromJSON(std::string_view json);
 
+  /* Streams the JSON form into sink section by section, without holding the whole document in memory. */
+  bool WriteJSON(const JsonSink& sink, bool withSensitiveData);
+
   /* GetAsFlatBuffer and SaveFromFlatBuffer are used for Reading/Writing the config file in its binary form. */
   [[nodiscard]] flatbuffers::Offset<Serialization::Configuration::HubConfig> GetAsFlatBuffer(flatbuffers::FlatBufferBuilder& builder, bool withSensitiveData);
   bool SaveFromFlatBuffer(const Serialization::Configuration::HubConfig* config);
@@ -81,6 +124,11 @@ namespace OpenShock::Config {
   bool SetBackendAuthToken(std::string token);
   bool ClearBackendAuthToken();
 
+  /* The last assigned LCG endpoint is kept in a separate file so that refreshing it never rewrites the main config. */
+  bool GetBackendLcgCache(std::string& host, uint16_t& port, std::string& path);
+  bool SetBackendLcgCache(std::string_view host, uint16_t port, std::string_view path);
+  bool ClearBackendLcgCache();
+
   bool GetSerialInputConfigEchoEnabled(bool& out);
   bool SetSerialInputConfigEchoEnabled(bool enabled);
 
@@ -89,6 +137,16 @@ namespace OpenShock::Config {
   bool GetOtaUpdateStep(OtaUpdateStep& out);
   bool SetOtaUpdateStep(OtaUpdateStep updateStep);
 
+  /* Progress of an interrupted partition flash, kept in a separate file so a download can resume after a reboot. */
+  bool GetOtaResumeState(std::string& partitionLabel, std::string& url, uint8_t (&hash)[32], uint32_t& offset);
+  bool SetOtaResumeState(std::string_view partitionLabel, std::string_view url, const uint8_t (&hash)[32], uint32_t offset);
+  bool ClearOtaResumeState();
+
+  /* Validators and body of recently fetched OTA metadata, kept in separate files so conditional requests keep working across reboots. */
+  bool GetHttpCacheEntry(std::string_view url, std::string& etag, std::string& lastModified, std::string& body);
+  bool SetHttpCacheEntry(std::string_view url, std::string_view etag, std::string_view lastModified, std::string_view body);
+  bool ClearHttpCache();
+
   bool GetEStopEnabled(bool& out);
   bool SetEStopEnabled(bool enabled);
   bool GetEStopGpioPin(gpio_num_t& out);
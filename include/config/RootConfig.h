@@ -9,7 +9,14 @@
 #include "config/SerialInputConfig.h"
 #include "config/WiFiConfig.h"
 
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
 namespace OpenShock::Config {
+  /// @brief Receives JSON text in pieces, returns false to abort
+  using JsonSink = std::function<bool(const char* data, std::size_t len)>;
+
   struct RootConfig : public ConfigBase<Serialization::Configuration::HubConfig> {
     RootConfig();
 
@@ -28,5 +35,9 @@ namespace OpenShock::Config {
 
     bool FromJSON(const cJSON* json) override;
     [[nodiscard]] cJSON* ToJSON(bool withSensitiveData) const override;
+
+    /* Same format as FromJSON/ToJSON, but only one section is ever held as a cJSON tree. */
+    bool ReadJSON(std::string_view json);
+    bool WriteJSON(const JsonSink& sink, bool withSensitiveData) const;
   };
 }  // namespace OpenShock::Config
@@ -6,7 +6,9 @@
 #include <hal/gpio_types.h>
 #include <IPAddress.h>
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace OpenShock::Config::Internal::Utils {
@@ -29,6 +31,10 @@ namespace OpenShock::Config::Internal::Utils {
   bool FromJsonGpioNum(gpio_num_t& val, const cJSON* json, const char* name);
   void FromJsonGpioNum(gpio_num_t& val, const cJSON* json, const char* name, gpio_num_t defaultVal);
 
+  /// @brief Walks the members of a JSON object without parsing their values, each value is passed as its raw text
+  /// @return False if json is not an object or the callback returned false
+  bool ForEachJsonMember(std::string_view json, const std::function<bool(std::string_view key, std::string_view value)>& callback);
+
   template<typename T, typename U>  // T inherits from ConfigBase<U>
   void FromFbsVec(std::vector<T>& vec, const flatbuffers::Vector<flatbuffers::Offset<U>>* fbsVec)
   {
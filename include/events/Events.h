@@ -11,6 +11,7 @@ ESP_EVENT_DECLARE_BASE(OPENSHOCK_EVENTS);
 enum {
   OPENSHOCK_EVENT_ESTOP_STATE_CHANGED,           // Event for when the EStop activation state changes
   OPENSHOCK_EVENT_GATEWAY_CLIENT_STATE_CHANGED,  // Event for when the gateway connection state changes
+  OPENSHOCK_EVENT_CONFIG_CHANGED,                // Event for when the config changes, data is OpenShock::Config::ChangedEventData
 };
 
 #ifdef __cplusplus
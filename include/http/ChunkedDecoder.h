@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace OpenShock::HTTP {
+  /// @brief Incremental decoder for "Transfer-Encoding: chunked" bodies
+  /// @remarks Payload is handed to the callback as slices of the caller's buffer, so nothing is copied or retained between feeds and chunks of any size stream straight through
+  class ChunkedDecoder {
+    DISABLE_COPY(ChunkedDecoder);
+    DISABLE_MOVE(ChunkedDecoder);
+
+  public:
+    enum class Result : uint8_t {
+      NeedMoreData,  // Input fully consumed, the body is not complete yet
+      Done,          // Terminating chunk and trailers were read
+      Invalid,       // Framing error
+      Cancelled,     // Payload callback returned false
+    };
+
+    using PayloadCallback = std::function<bool(const uint8_t* data, std::size_t len)>;
+
+    ChunkedDecoder(std::size_t maxChunkSize);
+
+    /// @brief Decodes the next slice of the body
+    /// @param consumed Number of input bytes processed, less than len only when Done is returned before the end of the input
+    Result Feed(const uint8_t* data, std::size_t len, std::size_t& consumed, const PayloadCallback& callback);
+
+    inline bool done() const { return m_state == State::Done; }
+
+  private:
+    enum class State : uint8_t {
+      Size,
+      Extension,
+      SizeLF,
+      Payload,
+      PayloadCR,
+      PayloadLF,
+      TrailerStart,
+      Trailer,
+      TrailerLF,
+      FinalLF,
+      Done,
+      Invalid,
+    };
+
+    Result fail(const char* reason);
+
+    std::size_t m_maxChunkSize;
+    std::size_t m_remaining;  // Payload bytes left in the current chunk
+    uint8_t m_sizeDigits;
+    State m_state;
+  };
+}  // namespace OpenShock::HTTP
@@ -8,6 +8,7 @@
 #include <map>
 #include <string_view>
 
+#include "serialization/JsonStream.h"
 #include "span.h"
 
 namespace OpenShock::HTTP {
@@ -56,13 +57,44 @@ namespace OpenShock::HTTP {
     }
   };
 
+  struct ConnectionPoolMetrics {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t exhausted;
+  };
+
+  struct DownloadMetrics {
+    uint32_t downloads;
+    uint64_t totalBytes;
+    uint64_t totalMs;
+    uint32_t lastBytes;
+    uint32_t lastMs;
+    uint32_t lastBytesPerSecond;
+  };
+
+  struct ResponseCacheMetrics {
+    uint32_t hits;    // Answered 304, served from the persisted copy
+    uint32_t misses;  // Full body downloaded
+  };
+
   template<typename T>
   using JsonParser               = std::function<bool(int code, const cJSON* json, T& data)>;
   using GotContentLengthCallback = std::function<bool(int contentLength)>;
   using DownloadCallback         = std::function<bool(std::size_t offset, const uint8_t* data, std::size_t len)>;
 
-  Response<std::size_t> Download(std::string_view url, const std::map<String, String>& headers, GotContentLengthCallback contentLengthCallback, DownloadCallback downloadCallback, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000);
+  /// @param rangeStart When non-zero, requests the body from this offset on. On 206 the callbacks receive the full size and absolute offsets, servers that ignore ranges restart at offset 0
+  /// @param rangeEnd When non-zero, the exclusive end of the requested range
+  Response<std::size_t> Download(std::string_view url, const std::map<String, String>& headers, GotContentLengthCallback contentLengthCallback, DownloadCallback downloadCallback, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000, std::size_t rangeStart = 0, std::size_t rangeEnd = 0);
   Response<std::string> GetString(std::string_view url, const std::map<String, String>& headers, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000);
+  /// @brief Like GetString, but revalidates a persisted copy with If-None-Match / If-Modified-Since, a 304 returns the cached body
+  Response<std::string> GetStringCached(std::string_view url, const std::map<String, String>& headers, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000);
+
+  DownloadMetrics GetDownloadMetrics();
+  ResponseCacheMetrics GetResponseCacheMetrics();
+  ConnectionPoolMetrics GetConnectionPoolMetrics();
+
+  /// @brief Closes pooled connections that have been idle for too long, called regularly from the main task
+  void ReapIdleConnections();
 
   template<typename T>
   Response<T> GetJSON(std::string_view url, const std::map<String, String>& headers, JsonParser<T> jsonParser, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000)
@@ -87,4 +119,34 @@ namespace OpenShock::HTTP {
 
     return {response.result, response.code, std::move(data)};
   }
+
+  /// @brief Like GetJSON, but feeds the body straight from the socket into the parser without buffering the document or building a cJSON tree
+  template<typename T>
+  Response<T> GetJSONStream(std::string_view url, const std::map<String, String>& headers, Serialization::JsonStream::Parser<T>& parser, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs = 10'000)
+  {
+    T data {};
+
+    Serialization::JsonStream::Reader reader([&parser, &data](const Serialization::JsonStream::Event& event) { return parser.OnEvent(event, data); });
+
+    auto response = Download(
+      url,
+      headers,
+      [](std::size_t contentLength) { return true; },
+      [&reader](std::size_t offset, const uint8_t* chunk, std::size_t len) { return reader.Feed(chunk, len); },
+      acceptedCodes,
+      timeoutMs
+    );
+    if (reader.failed()) {
+      return {RequestResult::ParseFailed, response.code, {}};
+    }
+    if (response.result != RequestResult::Success) {
+      return {response.result, response.code, {}};
+    }
+
+    if (!reader.Finish() || !parser.OnComplete(response.code, data)) {
+      return {RequestResult::ParseFailed, response.code, {}};
+    }
+
+    return {response.result, response.code, std::move(data)};
+  }
 }  // namespace OpenShock::HTTP
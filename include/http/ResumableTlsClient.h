@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Common.h"
+
+#include <WiFiClientSecure.h>
+
+#include <cstdint>
+
+namespace OpenShock::HTTP {
+  /// @brief Insecure (no CA verification) TLS client that resumes sessions through the shared TlsSessionCache
+  ///
+  /// The handshake mirrors arduino-esp32's start_ssl_client, with the cached session offered before the ClientHello is sent.
+  class ResumableTlsClient : public WiFiClientSecure {
+    DISABLE_COPY(ResumableTlsClient);
+    DISABLE_MOVE(ResumableTlsClient);
+
+  public:
+    ResumableTlsClient();
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+    int connect(const char* host, uint16_t port) override;
+    int connect(const char* host, uint16_t port, int32_t timeout) override;
+
+    /// @brief Underlying socket, WiFiClient::fd() does not see it since WiFiClientSecure keeps its own
+    inline int socketFd() const { return sslclient != nullptr ? sslclient->socket : -1; }
+
+  private:
+    int startTls(IPAddress ip, uint16_t port, const char* host, int32_t timeout);
+  };
+}  // namespace OpenShock::HTTP
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <mbedtls/ssl.h>
+
+#include <cstdint>
+#include <string_view>
+
+namespace OpenShock::HTTP::TlsSessionCache {
+  struct Metrics {
+    uint32_t handshakes;
+    uint32_t resumed;
+    uint32_t failed;
+    uint64_t totalHandshakeMs;
+    uint32_t lastHandshakeMs;
+  };
+
+  /// @brief Restores the cached session for the host into the given (already set up) SSL context, returns false if there is none
+  bool Restore(std::string_view host, mbedtls_ssl_context* ssl);
+  /// @brief Saves the session negotiated by a completed handshake, replacing the least recently used entry if full
+  void Store(std::string_view host, const mbedtls_ssl_context* ssl);
+  void Remove(std::string_view host);
+  void Clear();
+
+  void RecordHandshake(bool success, bool resumed, uint32_t durationMs);
+  Metrics GetMetrics();
+}  // namespace OpenShock::HTTP::TlsSessionCache
@@ -2,9 +2,15 @@
 
 #include "span.h"
 
+#include <cstddef>
 #include <cstdint>
 
 namespace OpenShock::MessageHandlers::WebSocket {
+  // Upper bound for a (possibly reassembled) gateway message, also used as the FlatBuffer verifier limit
+  const std::size_t GATEWAY_MAX_MESSAGE_SIZE = 8192;
+  // Upper bound for a (possibly reassembled) local captive portal message, also used as the FlatBuffer verifier limit
+  const std::size_t LOCAL_MAX_MESSAGE_SIZE = 4096;
+
   void HandleGatewayBinary(tcb::span<const uint8_t> data);
   void HandleLocalBinary(uint8_t socketId, tcb::span<const uint8_t> data);
 }
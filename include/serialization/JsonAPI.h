@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ShockerModelType.h"
+#include "serialization/JsonStream.h"
 
 #include <cJSON.h>
 
@@ -44,6 +45,28 @@ namespace OpenShock::Serialization::JsonAPI {
   bool ParseLcgInstanceDetailsJsonResponse(int code, const cJSON* root, LcgInstanceDetailsResponse& out);
   bool ParseBackendVersionJsonResponse(int code, const cJSON* root, BackendVersionResponse& out);
   bool ParseAccountLinkJsonResponse(int code, const cJSON* root, AccountLinkResponse& out);
-  bool ParseHubInfoJsonResponse(int code, const cJSON* root, HubInfoResponse& out);
   bool ParseAssignLcgJsonResponse(int code, const cJSON* root, AssignLcgResponse& out);
+
+  /// @brief Streams the hub info response so large shocker lists never have to exist as a document or cJSON tree in memory
+  class HubInfoStreamParser : public JsonStream::Parser<HubInfoResponse> {
+  public:
+    bool OnEvent(const JsonStream::Event& event, HubInfoResponse& out) override;
+    bool OnComplete(int code, HubInfoResponse& out) override;
+
+  private:
+    enum ShockerField : uint8_t {
+      ShockerFieldId    = 1 << 0,
+      ShockerFieldRfId  = 1 << 1,
+      ShockerFieldModel = 1 << 2,
+      ShockerFieldAll   = ShockerFieldId | ShockerFieldRfId | ShockerFieldModel,
+    };
+
+    bool onShockerField(const JsonStream::Event& event);
+
+    bool m_inData           = false;
+    bool m_inShockers       = false;
+    bool m_seenShockers     = false;
+    uint8_t m_shockerFields = 0;
+    HubInfoResponse::ShockerInfo m_shocker {};
+  };
 }  // namespace OpenShock::Serialization::JsonAPI
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Common.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace OpenShock::Serialization::JsonStream {
+  enum class EventType : uint8_t {
+    ObjectStart,
+    ObjectEnd,
+    ArrayStart,
+    ArrayEnd,
+    String,
+    Number,
+    Bool,
+    Null,
+  };
+
+  struct Event {
+    EventType type;
+    uint8_t depth;           // Depth of the value itself, the root value is at depth 0
+    std::string_view key;    // Key of the value in its parent object, empty for array elements, the root and End events
+    std::string_view value;  // Decoded text for String, raw text for Number, "true"/"false" for Bool
+
+    inline bool Is(EventType t, uint8_t d, std::string_view k) const { return type == t && depth == d && key == k; }
+  };
+
+  using EventHandler = std::function<bool(const Event& event)>;
+
+  /// @brief Incremental JSON tokenizer that can be fed arbitrary slices of a document
+  /// @remarks Only the key and the value currently being read are buffered, so memory use is bounded by MAX_TOKEN_LENGTH and MAX_DEPTH instead of the document size
+  class Reader {
+    DISABLE_COPY(Reader);
+    DISABLE_MOVE(Reader);
+
+  public:
+    static const std::size_t MAX_DEPTH        = 16;
+    static const std::size_t MAX_TOKEN_LENGTH = 1024;
+
+    Reader(EventHandler handler);
+
+    /// @brief Tokenizes the next slice of the document, invoking the handler for every complete value
+    /// @return False if the document is malformed or the handler returned false
+    bool Feed(const uint8_t* data, std::size_t len);
+
+    /// @brief Flushes a trailing top-level number and verifies the document is complete
+    bool Finish();
+
+    inline bool failed() const { return m_state == State::Failed; }
+
+  private:
+    enum class State : uint8_t {
+      ExpectValue,
+      ExpectValueOrEnd,
+      ExpectKeyOrEnd,
+      ExpectKey,
+      ExpectColon,
+      ExpectCommaOrEnd,
+      InString,
+      InStringEscape,
+      InStringUnicode,
+      InNumber,
+      InLiteral,
+      Done,
+      Failed,
+    };
+
+    bool processByte(char c);
+    bool beginValue(char c);
+    bool endValue();
+    bool closeContainer(char c);
+    bool finishString();
+    bool finishNumber();
+    bool finishLiteral();
+    bool appendToken(char c);
+    bool appendCodepoint(uint32_t codepoint);
+    bool emit(EventType type, std::string_view value);
+    bool fail(const char* reason);
+
+    EventHandler m_handler;
+    State m_state;
+    bool m_readingKey;
+    uint8_t m_depth;
+    uint8_t m_unicodeDigits;
+    uint16_t m_unicodeValue;
+    uint16_t m_highSurrogate;
+    std::array<char, MAX_DEPTH> m_containers;  // '{' or '[' for every open container
+    std::string m_key;
+    std::string m_token;
+  };
+
+  /// @brief Base for parsers that build a result from a stream of events instead of a cJSON tree
+  template<typename T>
+  class Parser {
+  public:
+    virtual ~Parser() = default;
+
+    virtual bool OnEvent(const Event& event, T& data) = 0;
+    virtual bool OnComplete(int code, T& data)        = 0;
+  };
+}  // namespace OpenShock::Serialization::JsonStream
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FirmwareBootType.h"
+#include "GatewayLinkQuality.h"
 #include "SemVer.h"
 #include "serialization/CallbackFn.h"
 
@@ -11,7 +12,7 @@
 #define SERIALIZER_FN(NAME, ...) bool Serialize##NAME##Message(__VA_ARGS__ __VA_OPT__(, ) Common::SerializationCallbackFn callback)
 
 namespace OpenShock::Serialization::Gateway {
-  SERIALIZER_FN(Pong);
+  SERIALIZER_FN(Pong, const OpenShock::GatewayLinkQuality* linkQuality);
   SERIALIZER_FN(BootStatus, int32_t updateId, OpenShock::FirmwareBootType bootType);
   SERIALIZER_FN(OtaUpdateStarted, int32_t updateId, const OpenShock::SemVer& version);
   SERIALIZER_FN(OtaUpdateProgress, int32_t updateId, Types::OtaUpdateProgressTask task, float progress);
@@ -115,6 +115,7 @@ bool VerifyHubToGatewayMessagePayload(::flatbuffers::VerifierTemplate<B> &verifi
 template <bool B = false>
 bool VerifyHubToGatewayMessagePayloadVector(::flatbuffers::VerifierTemplate<B> &verifier, const ::flatbuffers::Vector<::flatbuffers::Offset<void>> *values, const ::flatbuffers::Vector<HubToGatewayMessagePayload> *types);
 
+// HAND-PATCHED: the rtt_* and probes_* fields are not in HubToGatewayMessage.fbs yet, see FLATBUFFERS_CHANGES.md
 struct Pong FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
   typedef PongBuilder Builder;
   struct Traits;
@@ -123,7 +124,12 @@ struct Pong FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
   }
   enum FlatBuffersVTableOffset FLATBUFFERS_VTABLE_UNDERLYING_TYPE {
     VT_UPTIME = 4,
-    VT_RSSI = 6
+    VT_RSSI = 6,
+    VT_RTT_EWMA_US = 8,
+    VT_RTT_JITTER_US = 10,
+    VT_RTT_HISTOGRAM = 12,
+    VT_PROBES_SENT = 14,
+    VT_PROBES_LOST = 16
   };
   uint64_t uptime() const {
     return GetField<uint64_t>(VT_UPTIME, 0);
@@ -131,11 +137,35 @@ struct Pong FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
   int32_t rssi() const {
     return GetField<int32_t>(VT_RSSI, 0);
   }
+  /// Smoothed round-trip time of hub-initiated probes in microseconds
+  uint32_t rtt_ewma_us() const {
+    return GetField<uint32_t>(VT_RTT_EWMA_US, 0);
+  }
+  /// Round-trip time variation of hub-initiated probes in microseconds
+  uint32_t rtt_jitter_us() const {
+    return GetField<uint32_t>(VT_RTT_JITTER_US, 0);
+  }
+  /// Round-trip time histogram, bucket upper bounds are 25, 50, 100, 200, 400, 800, 1600 ms and open-ended
+  const ::flatbuffers::Vector<uint16_t> *rtt_histogram() const {
+    return GetPointer<const ::flatbuffers::Vector<uint16_t> *>(VT_RTT_HISTOGRAM);
+  }
+  uint32_t probes_sent() const {
+    return GetField<uint32_t>(VT_PROBES_SENT, 0);
+  }
+  uint32_t probes_lost() const {
+    return GetField<uint32_t>(VT_PROBES_LOST, 0);
+  }
   template <bool B = false>
   bool Verify(::flatbuffers::VerifierTemplate<B> &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyField<uint64_t>(verifier, VT_UPTIME, 8) &&
            VerifyField<int32_t>(verifier, VT_RSSI, 4) &&
+           VerifyField<uint32_t>(verifier, VT_RTT_EWMA_US, 4) &&
+           VerifyField<uint32_t>(verifier, VT_RTT_JITTER_US, 4) &&
+           VerifyOffset(verifier, VT_RTT_HISTOGRAM) &&
+           verifier.VerifyVector(rtt_histogram()) &&
+           VerifyField<uint32_t>(verifier, VT_PROBES_SENT, 4) &&
+           VerifyField<uint32_t>(verifier, VT_PROBES_LOST, 4) &&
            verifier.EndTable();
   }
 };
@@ -150,6 +180,21 @@ struct PongBuilder {
   void add_rssi(int32_t rssi) {
     fbb_.AddElement<int32_t>(Pong::VT_RSSI, rssi, 0);
   }
+  void add_rtt_ewma_us(uint32_t rtt_ewma_us) {
+    fbb_.AddElement<uint32_t>(Pong::VT_RTT_EWMA_US, rtt_ewma_us, 0);
+  }
+  void add_rtt_jitter_us(uint32_t rtt_jitter_us) {
+    fbb_.AddElement<uint32_t>(Pong::VT_RTT_JITTER_US, rtt_jitter_us, 0);
+  }
+  void add_rtt_histogram(::flatbuffers::Offset<::flatbuffers::Vector<uint16_t>> rtt_histogram) {
+    fbb_.AddOffset(Pong::VT_RTT_HISTOGRAM, rtt_histogram);
+  }
+  void add_probes_sent(uint32_t probes_sent) {
+    fbb_.AddElement<uint32_t>(Pong::VT_PROBES_SENT, probes_sent, 0);
+  }
+  void add_probes_lost(uint32_t probes_lost) {
+    fbb_.AddElement<uint32_t>(Pong::VT_PROBES_LOST, probes_lost, 0);
+  }
   explicit PongBuilder(::flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -164,9 +209,19 @@ struct PongBuilder {
 inline ::flatbuffers::Offset<Pong> CreatePong(
     ::flatbuffers::FlatBufferBuilder &_fbb,
     uint64_t uptime = 0,
-    int32_t rssi = 0) {
+    int32_t rssi = 0,
+    uint32_t rtt_ewma_us = 0,
+    uint32_t rtt_jitter_us = 0,
+    ::flatbuffers::Offset<::flatbuffers::Vector<uint16_t>> rtt_histogram = 0,
+    uint32_t probes_sent = 0,
+    uint32_t probes_lost = 0) {
   PongBuilder builder_(_fbb);
   builder_.add_uptime(uptime);
+  builder_.add_probes_lost(probes_lost);
+  builder_.add_probes_sent(probes_sent);
+  builder_.add_rtt_histogram(rtt_histogram);
+  builder_.add_rtt_jitter_us(rtt_jitter_us);
+  builder_.add_rtt_ewma_us(rtt_ewma_us);
   builder_.add_rssi(rssi);
   return builder_.Finish();
 }
@@ -176,6 +231,27 @@ struct Pong::Traits {
   static auto constexpr Create = CreatePong;
 };
 
+inline ::flatbuffers::Offset<Pong> CreatePongDirect(
+    ::flatbuffers::FlatBufferBuilder &_fbb,
+    uint64_t uptime = 0,
+    int32_t rssi = 0,
+    uint32_t rtt_ewma_us = 0,
+    uint32_t rtt_jitter_us = 0,
+    const std::vector<uint16_t> *rtt_histogram = nullptr,
+    uint32_t probes_sent = 0,
+    uint32_t probes_lost = 0) {
+  auto rtt_histogram__ = rtt_histogram ? _fbb.CreateVector<uint16_t>(*rtt_histogram) : 0;
+  return OpenShock::Serialization::Gateway::CreatePong(
+      _fbb,
+      uptime,
+      rssi,
+      rtt_ewma_us,
+      rtt_jitter_us,
+      rtt_histogram__,
+      probes_sent,
+      probes_lost);
+}
+
 struct BootStatus FLATBUFFERS_FINAL_CLASS : private ::flatbuffers::Table {
   typedef BootStatusBuilder Builder;
   struct Traits;
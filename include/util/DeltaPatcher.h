@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Common.h"
+
+#include <esp_partition.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace OpenShock {
+  /// @brief Rebuilds an image from a streamed delta patch and the image already on a source partition
+  ///
+  /// Patch layout, all integers little endian:
+  ///   Header: "OSDP", u8 version, u32 source size, u32 target size, u8[32] SHA-256 of the source image
+  ///   Ops:    u8 op, u32 source offset, u32 length, followed by length bytes for ADD and INSERT
+  ///           COPY   copies length bytes from the source
+  ///           ADD    adds each patch byte to the matching source byte, like bsdiff, so shifted code diffs into mostly zeros
+  ///           INSERT emits the patch bytes as-is, the source offset is ignored
+  ///   A single END op byte terminates the patch.
+  ///
+  /// Output is produced strictly in order, so it can be streamed straight into another partition.
+  class DeltaPatcher {
+    DISABLE_COPY(DeltaPatcher);
+    DISABLE_MOVE(DeltaPatcher);
+
+  public:
+    using OutputCallback = std::function<bool(const uint8_t* data, std::size_t len)>;
+
+    static const std::size_t BUFFER_SIZE = 4096;
+
+    DeltaPatcher(const esp_partition_t* source);
+    ~DeltaPatcher();
+
+    inline bool ok() const { return m_buffer != nullptr; }
+
+    void reset();
+
+    /// @brief Applies the next slice of the patch, returns false on a malformed patch, a source mismatch, or if the callback returns false
+    bool feed(const uint8_t* data, std::size_t len, const OutputCallback& output);
+
+    /// @brief True once the END op was seen and the output matched the target size
+    inline bool done() const { return m_state == State::Done; }
+    inline std::size_t outputSize() const { return m_outputSize; }
+
+  private:
+    static const std::size_t HEADER_SIZE    = 4 + 1 + 4 + 4 + 32;
+    static const std::size_t OP_HEADER_SIZE = 1 + 4 + 4;
+
+    enum class State : uint8_t {
+      Header,
+      Op,
+      Add,
+      Insert,
+      Done,
+      Failed,
+    };
+
+    bool parseHeader();
+    bool beginOp(const OutputCallback& output);
+    bool verifySource();
+    bool readSource(std::size_t offset, std::size_t len);
+    bool fail(const char* reason);
+
+    const esp_partition_t* m_source;
+    uint8_t* m_buffer;
+    uint8_t m_field[HEADER_SIZE];
+    std::size_t m_fieldPos;
+    State m_state;
+    uint32_t m_sourceSize;
+    uint32_t m_targetSize;
+    uint32_t m_opOffset;
+    uint32_t m_opRemaining;
+    std::size_t m_outputSize;
+  };
+}  // namespace OpenShock
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+struct tinfl_decompressor_tag;
+
+namespace OpenShock {
+  /// @brief Streaming gzip (RFC 1952) decoder built on the inflater in the ESP32 ROM
+  ///
+  /// Input can be fed in slices of any size. Output is produced straight from the 32 KB inflate window, so memory use is fixed regardless of the image size.
+  class GzipDecoder {
+    DISABLE_COPY(GzipDecoder);
+    DISABLE_MOVE(GzipDecoder);
+
+  public:
+    using OutputCallback = std::function<bool(const uint8_t* data, std::size_t len)>;
+
+    GzipDecoder();
+    ~GzipDecoder();
+
+    inline bool ok() const { return m_inflator != nullptr && m_window != nullptr; }
+
+    void reset();
+
+    /// @brief Decodes the next slice of the stream, returns false on corrupt input or if the callback returns false
+    bool feed(const uint8_t* data, std::size_t len, const OutputCallback& output);
+
+    /// @brief True once the deflate stream ended and the trailer matched the decoded size
+    inline bool done() const { return m_state == State::Done; }
+    inline std::size_t outputSize() const { return m_outputSize; }
+
+  private:
+    enum class State : uint8_t {
+      Header,
+      ExtraLength,
+      Extra,
+      Name,
+      Comment,
+      HeaderCrc,
+      Deflate,
+      Trailer,
+      Done,
+      Failed,
+    };
+
+    bool parseHeaderByte(uint8_t c);
+    bool inflate(const uint8_t*& data, std::size_t& len, const OutputCallback& output);
+    bool fail(const char* reason);
+
+    tinfl_decompressor_tag* m_inflator;
+    uint8_t* m_window;
+    std::size_t m_windowOffset;
+    std::size_t m_outputSize;
+    State m_state;
+    uint8_t m_flags;
+    uint8_t m_fieldPos;
+    uint16_t m_fieldLength;
+    uint8_t m_trailer[8];
+  };
+}  // namespace OpenShock
@@ -7,6 +7,14 @@
 #include <string_view>
 
 namespace OpenShock {
+  enum class PartitionCompression : uint8_t {
+    None,
+    Gzip,  // Inflated while streaming, the hash is still checked against the uncompressed image
+  };
+
   bool TryGetPartitionHash(const esp_partition_t* partition, char (&hash)[65]);
-  bool FlashPartitionFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback = nullptr);
+  /// @param patchSource When set, the remote file is a delta patch (see DeltaPatcher) against the image on this partition
+  bool FlashPartitionFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback = nullptr, PartitionCompression compression = PartitionCompression::None, const esp_partition_t* patchSource = nullptr);
+  /// @brief Downloads and rewrites only the 4 KiB blocks whose hash differs from the published block list, then verifies the whole image
+  bool FlashPartitionBlocksFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, std::string_view blockHashesUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback);
 }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Common.h"
+#include "Hashing.h"
+
+#include <esp_partition.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace OpenShock {
+  /// @brief Writes a contiguous stream to a partition from a separate task, so the network keeps receiving while flash programs and hashes
+  ///
+  /// Data is copied into one of BUFFER_COUNT fixed buffers; full buffers are queued to the writer task, which writes and hashes them and hands them back.
+  /// When every buffer is in flight the producer blocks, giving natural backpressure.
+  /// Flash is erased just ahead of the write cursor and only up to the image size, instead of wiping the whole partition up front.
+  class PartitionWriter {
+    DISABLE_COPY(PartitionWriter);
+    DISABLE_MOVE(PartitionWriter);
+
+  public:
+    static const std::size_t BUFFER_SIZE  = 8192;
+    static const std::size_t BUFFER_COUNT = 3;
+    static const std::size_t ERASE_AHEAD  = 64 * 1024;  // Matches the flash block size, so erases can use block instead of sector commands
+
+    /// @param offset Sector aligned offset to start writing at, everything from here on is treated as not yet erased
+    PartitionWriter(const esp_partition_t* partition, SHA256& sha256, std::size_t offset);
+    ~PartitionWriter();
+
+    inline bool ok() const { return m_freeQueue != nullptr && m_fullQueue != nullptr && m_taskHandle != nullptr && !m_failed; }
+
+    /// @brief Queues data for writing, offset must continue where the previous write ended
+    bool write(std::size_t offset, const uint8_t* data, std::size_t length);
+    /// @brief Submits any partially filled buffer and waits until everything queued is written and hashed
+    bool flush();
+    /// @brief Moves the write cursor to a sector aligned offset, only valid right after a successful flush
+    void reset(std::size_t offset);
+    /// @brief Limits erasing to the sectors covering the image, defaults to the whole partition
+    inline void setImageSize(std::size_t size) { m_imageSize = size; }
+
+    /// @brief End offset of the data that is on flash and included in the hash
+    inline std::size_t committed() const { return m_committed; }
+    /// @brief Milliseconds from construction until the first block reached flash, -1 if none has yet
+    inline int64_t firstCommitMs() const { return m_firstCommitMs; }
+
+  private:
+    struct Block {
+      uint8_t index;
+      uint32_t offset;
+      uint32_t length;
+    };
+
+    void destroy();
+    void WriterTask();
+    bool acquireBuffer();
+    bool submitBuffer();
+    bool eraseAhead(std::size_t end);
+
+    const esp_partition_t* m_partition;
+    SHA256& m_sha256;
+    std::array<uint8_t*, BUFFER_COUNT> m_buffers;
+    QueueHandle_t m_freeQueue;  // Buffer indices ready to be filled
+    QueueHandle_t m_fullQueue;  // Blocks waiting to be written
+    TaskHandle_t m_taskHandle;
+    uint8_t m_fillIndex;
+    bool m_hasFill;
+    std::size_t m_fillOffset;
+    std::size_t m_fillLength;
+    std::size_t m_erasedUntil;  // Only touched by the writer task, and by reset() while it is idle
+    std::atomic<std::size_t> m_imageSize;
+    std::atomic<std::size_t> m_committed;
+    std::atomic<bool> m_failed;
+    int64_t m_createdAt;
+    std::atomic<int64_t> m_firstCommitMs;
+  };
+}  // namespace OpenShock
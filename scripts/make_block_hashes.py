@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Filesystem Block Hash Generator
+
+Writes the per-block hash list the firmware uses to rewrite only the changed
+4 KiB blocks of the static filesystem partition (see FlashPartitionBlocksFromUrl).
+With --compare, also simulates an update from an older image and reports the
+blocks written and bytes fetched.
+"""
+
+import hashlib
+import sys
+from pathlib import Path
+from typing import List, Tuple
+
+# Constants, must match src/util/ParitionUtils.cpp
+BLOCK_SIZE = 4096
+MERGE_GAP = 4
+MAX_RANGES = 6
+
+
+def main():
+    """Main entry point for the block hash generator."""
+    args = sys.argv[1:]
+    old_path = None
+    if len(args) == 4 and args[2] == "--compare":
+        old_path = Path(args[3])
+        args = args[:2]
+
+    if len(args) != 2:
+        print("Usage: make_block_hashes.py <staticfs_binary> <output_file> [--compare <old_staticfs_binary>]", file=sys.stderr)
+        sys.exit(1)
+
+    image_path = Path(args[0])
+    output_path = Path(args[1])
+
+    if not image_path.exists():
+        print(f"Error: Binary file not found: {image_path}", file=sys.stderr)
+        sys.exit(1)
+
+    image = image_path.read_bytes()
+    hashes = block_hashes(image)
+
+    lines = [str(len(image))] + [h.hex() for h in hashes]
+    output_path.write_text("\n".join(lines) + "\n")
+    print(f"Wrote {len(hashes)} block hashes for {len(image)} bytes")
+
+    if old_path is not None:
+        simulate(old_path.read_bytes(), image, hashes)
+
+
+def block_hashes(image: bytes) -> List[bytes]:
+    """Hash every block, padding the last one with 0xFF like erased flash."""
+    hashes = []
+    for offset in range(0, len(image), BLOCK_SIZE):
+        block = image[offset:offset + BLOCK_SIZE].ljust(BLOCK_SIZE, b"\xFF")
+        hashes.append(hashlib.sha256(block).digest())
+    return hashes
+
+
+def plan_ranges(changed: List[int]) -> List[Tuple[int, int]]:
+    """Join changed block indices into inclusive ranges, the same way the firmware does."""
+    ranges = []
+    for index in changed:
+        if ranges and index - ranges[-1][1] <= MERGE_GAP + 1:
+            ranges[-1] = (ranges[-1][0], index)
+        else:
+            ranges.append((index, index))
+
+    while len(ranges) > MAX_RANGES:
+        best = min(range(len(ranges) - 1), key=lambda i: ranges[i + 1][0] - ranges[i][1])
+        ranges[best:best + 2] = [(ranges[best][0], ranges[best + 1][1])]
+
+    return ranges
+
+
+def simulate(old: bytes, new: bytes, hashes: List[bytes]):
+    """Report what updating a partition holding old to new would cost."""
+    # The partition holds old followed by erased flash
+    local = old.ljust(len(hashes) * BLOCK_SIZE, b"\xFF")
+    changed = [i for i, h in enumerate(hashes) if hashlib.sha256(local[i * BLOCK_SIZE:(i + 1) * BLOCK_SIZE]).digest() != h]
+
+    ranges = plan_ranges(changed)
+    fetched = sum(min((last + 1) * BLOCK_SIZE, len(new)) - first * BLOCK_SIZE for first, last in ranges)
+
+    print(f"Blocks written: {len(changed)} / {len(hashes)}")
+    print(f"Bytes fetched:  {fetched} / {len(new)} ({fetched * 100 / len(new):.1f}%) in {len(ranges)} requests")
+
+
+if __name__ == "__main__":
+    main()
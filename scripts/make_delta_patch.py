@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+OTA Delta Patch Generator
+
+Builds a delta patch that turns one firmware image into another, in the
+format applied by DeltaPatcher on the device (see include/util/DeltaPatcher.h).
+"""
+
+import gzip
+import hashlib
+import struct
+import sys
+from pathlib import Path
+
+# Constants
+MAGIC = b"OSDP"
+VERSION = 1
+
+OP_END = 0
+OP_COPY = 1
+OP_ADD = 2
+OP_INSERT = 3
+
+MATCH_SIZE = 32  # Shortest run of identical bytes worth a COPY
+INDEX_STRIDE = 8  # Source positions indexed, matches are found for runs of MATCH_SIZE + INDEX_STRIDE bytes
+ADD_MIN_SIMILARITY = 0.5  # Fraction of equal bytes for a gap to be encoded as ADD instead of INSERT
+
+
+def main():
+    """Main entry point for the patch generator."""
+    if len(sys.argv) not in (4, 5) or (len(sys.argv) == 5 and sys.argv[4] != "--gzip"):
+        print("Usage: make_delta_patch.py <old_binary> <new_binary> <patch_file> [--gzip]", file=sys.stderr)
+        sys.exit(1)
+
+    old_path = Path(sys.argv[1])
+    new_path = Path(sys.argv[2])
+    patch_path = Path(sys.argv[3])
+    compress = len(sys.argv) == 5
+
+    for path in (old_path, new_path):
+        if not path.exists():
+            print(f"Error: Binary file not found: {path}", file=sys.stderr)
+            sys.exit(1)
+
+    old = old_path.read_bytes()
+    new = new_path.read_bytes()
+
+    patch = make_patch(old, new)
+    if compress:
+        patch = gzip.compress(patch, compresslevel=9)
+
+    patch_path.write_bytes(patch)
+    print(f"Patch size: {len(patch)} bytes ({len(patch) * 100 / len(new):.1f}% of {len(new)} bytes)")
+
+
+def make_patch(old: bytes, new: bytes) -> bytes:
+    """
+    Encode new as a sequence of COPY, ADD and INSERT ops against old.
+
+    Args:
+        old: Image currently on the device
+        new: Image to reconstruct
+
+    Returns:
+        The uncompressed patch
+    """
+    out = bytearray(MAGIC)
+    out += struct.pack("<BII", VERSION, len(old), len(new))
+    out += hashlib.sha256(old).digest()
+
+    index = {}
+    for i in range(0, len(old) - MATCH_SIZE + 1, INDEX_STRIDE):
+        index.setdefault(old[i:i + MATCH_SIZE], i)
+
+    # Gaps between exact matches are diffed against the source right after the previous match, as code usually shifts as a block
+    gap_start = 0
+    source_cursor = 0
+    t = 0
+    while t <= len(new) - MATCH_SIZE:
+        s = index.get(new[t:t + MATCH_SIZE])
+        if s is None:
+            t += 1
+            continue
+
+        while t > gap_start and s > 0 and old[s - 1] == new[t - 1]:
+            s -= 1
+            t -= 1
+
+        n = MATCH_SIZE
+        while t + n < len(new) and s + n < len(old) and old[s + n] == new[t + n]:
+            n += 1
+
+        emit_gap(out, old, new, gap_start, t, source_cursor)
+        out += struct.pack("<BII", OP_COPY, s, n)
+
+        t += n
+        gap_start = t
+        source_cursor = s + n
+
+    emit_gap(out, old, new, gap_start, len(new), source_cursor)
+    out.append(OP_END)
+
+    return bytes(out)
+
+
+def emit_gap(out: bytearray, old: bytes, new: bytes, start: int, end: int, source_offset: int):
+    """Append the ops for new[start:end], which has no exact match in old."""
+    length = end - start
+    if length == 0:
+        return
+
+    if source_offset + length <= len(old):
+        source = old[source_offset:source_offset + length]
+        target = new[start:end]
+        equal = sum(1 for a, b in zip(source, target) if a == b)
+        if equal >= length * ADD_MIN_SIMILARITY:
+            out += struct.pack("<BII", OP_ADD, source_offset, length)
+            out += bytes((b - a) & 0xFF for a, b in zip(source, target))
+            return
+
+    out += struct.pack("<BII", OP_INSERT, 0, length)
+    out += new[start:end]
+
+
+if __name__ == "__main__":
+    main()
@@ -12,13 +12,20 @@ const char* const TAG = "GatewayClient";
 #include "serialization/WSGateway.h"
 #include "visual/VisualStateManager.h"
 
+#include <cstring>
+
 using namespace OpenShock;
 
+using MessageHandlers::WebSocket::GATEWAY_MAX_MESSAGE_SIZE;
+
 static bool s_bootStatusSent = false;
 
 GatewayClient::GatewayClient(const std::string& authToken)
   : m_webSocket()
   , m_state(GatewayClientState::Disconnected)
+  , m_linkQuality()
+  , m_fragmentState(FragmentState::None)
+  , m_fragmentArena()
 {
   OS_LOGD(TAG, "Creating GatewayClient");
 
@@ -104,6 +111,8 @@ bool GatewayClient::loop()
     return true;
   }
 
+  _sendLinkProbe();
+
   return true;
 }
 
@@ -153,13 +162,71 @@ void GatewayClient::_sendBootStatus()
   }
 }
 
+void GatewayClient::_sendLinkProbe()
+{
+  int64_t now = OpenShock::micros();
+  if (!m_linkQuality.shouldProbe(now)) {
+    return;
+  }
+
+  // The echo ID is sent as the ping payload, which the remote echoes back in its pong
+  uint32_t echoId = m_linkQuality.onProbeSent(now);
+
+  uint8_t payload[sizeof(echoId)];
+  memcpy(payload, &echoId, sizeof(echoId));
+
+  if (!m_webSocket.sendPing(payload, sizeof(payload))) {
+    OS_LOGW(TAG, "Failed to send link probe");
+  }
+}
+
+void GatewayClient::_handleFragment(WStype_t type, const uint8_t* payload, std::size_t length)
+{
+  if (type == WStype_FRAGMENT_BIN_START) {
+    // Arena is allocated once at its capped size and reused for every fragmented message after that
+    if (m_fragmentArena.capacity() < GATEWAY_MAX_MESSAGE_SIZE) {
+      m_fragmentArena.reserve(GATEWAY_MAX_MESSAGE_SIZE);
+    }
+
+    m_fragmentArena.clear();
+    m_fragmentState = FragmentState::Binary;
+  } else if (m_fragmentState == FragmentState::None) {
+    OS_LOGW(TAG, "Received continuation fragment without a start fragment, ignoring");
+    return;
+  }
+
+  if (m_fragmentState == FragmentState::Binary) {
+    if (length > m_fragmentArena.capacity() - m_fragmentArena.size()) {
+      OS_LOGE(TAG, "Fragmented message exceeds %zu bytes, discarding", GATEWAY_MAX_MESSAGE_SIZE);
+      m_fragmentArena.clear();
+      m_fragmentState = FragmentState::Discarding;
+    } else {
+      m_fragmentArena.append(payload, length);
+    }
+  }
+
+  if (type != WStype_FRAGMENT_FIN) {
+    return;
+  }
+
+  if (m_fragmentState == FragmentState::Binary) {
+    MessageHandlers::WebSocket::HandleGatewayBinary(tcb::span<const uint8_t>(m_fragmentArena.data(), m_fragmentArena.size()));
+  }
+
+  m_fragmentArena.clear();
+  m_fragmentState = FragmentState::None;
+}
+
 void GatewayClient::_handleEvent(WStype_t type, uint8_t* payload, std::size_t length)
 {
   switch (type) {
     case WStype_DISCONNECTED:
+      m_fragmentArena.clear();
+      m_fragmentState = FragmentState::None;
       _setState(GatewayClientState::Disconnected);
       break;
     case WStype_CONNECTED:
+      m_linkQuality.reset();
       _setState(GatewayClientState::Connected);
       _sendBootStatus();
       break;
@@ -170,22 +237,26 @@ void GatewayClient::_handleEvent(WStype_t type, uint8_t* payload, std::size_t le
       OS_LOGE(TAG, "Received error from API");
       break;
     case WStype_FRAGMENT_TEXT_START:
-      OS_LOGD(TAG, "Received fragment text start from API");
+      OS_LOGW(TAG, "Received fragmented text from API, JSON parsing is not supported anymore :D");
+      m_fragmentArena.clear();
+      m_fragmentState = FragmentState::Discarding;
       break;
+    case WStype_FRAGMENT_BIN_START:
     case WStype_FRAGMENT:
-      OS_LOGD(TAG, "Received fragment from API");
-      break;
     case WStype_FRAGMENT_FIN:
-      OS_LOGD(TAG, "Received fragment fin from API");
+      _handleFragment(type, payload, length);
       break;
     case WStype_BIN:
       MessageHandlers::WebSocket::HandleGatewayBinary(tcb::span<const uint8_t>(payload, length));
       break;
-    case WStype_FRAGMENT_BIN_START:
-      OS_LOGE(TAG, "Received binary fragment start from API, this is not supported!");
-      break;
     case WStype_PING:
+      break;
     case WStype_PONG:
+      if (length == sizeof(uint32_t)) {
+        uint32_t echoId;
+        memcpy(&echoId, payload, sizeof(echoId));
+        m_linkQuality.onProbeAnswered(echoId, OpenShock::micros());
+      }
       break;
     default:
       OS_LOGE(TAG, "Received unknown event from API");
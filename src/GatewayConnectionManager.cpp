@@ -11,6 +11,7 @@ const char* const TAG = "GatewayConnectionManager";
 #include "http/JsonAPI.h"
 #include "Logging.h"
 #include "serialization/WSLocal.h"
+#include "util/TaskUtils.h"
 
 #include "SimpleMutex.h"
 
@@ -40,13 +41,39 @@ const uint8_t FLAG_LINKED = 1 << 1;
 
 const uint8_t LINK_CODE_LENGTH = 6;
 
-static std::atomic<uint8_t> s_flags                 = 0;
-static std::atomic<int64_t> s_lastAuthFailure       = 0;
-static std::atomic<int64_t> s_lastConnectionAttempt = 0;
-static std::atomic_flag s_isInitializing            = ATOMIC_FLAG_INIT;
+const int64_t LCG_CACHE_TTL_MS = 6 * 60 * 60 * 1000;  // 6 hours
+
+enum class HubInfoState : uint8_t {
+  Unverified,
+  Fetching,
+  Verified,
+  Rejected,
+};
+
+struct LcgEndpoint {
+  std::string host;
+  uint16_t port;
+  std::string path;
+  int64_t verifiedAt;  // 0 if loaded from flash and not yet connected to during this boot
+};
+
+static std::atomic<uint8_t> s_flags                       = 0;
+static std::atomic<int64_t> s_lastAuthFailure             = 0;
+static std::atomic<int64_t> s_lastConnectionAttempt       = 0;
+static std::atomic<int64_t> s_lastCachedConnectionAttempt = 0;
+static std::atomic<int64_t> s_lastHubInfoAttempt          = 0;
+static std::atomic<HubInfoState> s_hubInfoState           = HubInfoState::Unverified;
+static std::atomic<bool> s_lcgCacheLoaded                 = false;
+static std::atomic_flag s_isInitializing                  = ATOMIC_FLAG_INIT;
 static OpenShock::SimpleMutex s_clientMutex;
+static OpenShock::SimpleMutex s_linkMutex;  // Orders auth token changes against hub info results arriving from the fetch task
 static std::shared_ptr<OpenShock::GatewayClient> s_wsClient = nullptr;
 
+// Only accessed from the Update() task
+static LcgEndpoint s_lcgCache        = {};
+static bool s_lcgCacheValid          = false;
+static bool s_lcgCacheAttemptPending = false;
+
 static std::shared_ptr<OpenShock::GatewayClient> GetClient()
 {
   OpenShock::ScopedLock lock__(&s_clientMutex);
@@ -88,6 +115,64 @@ static bool checkIsConnectionRateLimited(int64_t millis)
 {
   return s_lastConnectionAttempt != 0 && (millis - s_lastConnectionAttempt) < 20'000;  // 20 seconds
 }
+static bool checkIsCachedConnectionRateLimited(int64_t millis)
+{
+  return s_lastCachedConnectionAttempt != 0 && (millis - s_lastCachedConnectionAttempt) < 2000;  // 2 seconds, does not hit the API
+}
+static bool checkIsHubInfoRateLimited(int64_t millis)
+{
+  return s_lastHubInfoAttempt != 0 && (millis - s_lastHubInfoAttempt) < 20'000;  // 20 seconds
+}
+
+static bool tryGetCachedLcg(int64_t millis, const LcgEndpoint*& out)
+{
+  if (!s_lcgCacheLoaded) {
+    s_lcgCacheLoaded      = true;
+    s_lcgCacheValid       = OpenShock::Config::GetBackendLcgCache(s_lcgCache.host, s_lcgCache.port, s_lcgCache.path);
+    s_lcgCache.verifiedAt = 0;
+  }
+
+  if (!s_lcgCacheValid) {
+    return false;
+  }
+
+  // Entries loaded from flash have no usable timestamp (no wall clock), they get a single attempt after boot
+  if (s_lcgCache.verifiedAt != 0 && (millis - s_lcgCache.verifiedAt) > LCG_CACHE_TTL_MS) {
+    OS_LOGD(TAG, "Cached LCG endpoint expired");
+    s_lcgCacheValid = false;
+    return false;
+  }
+
+  out = &s_lcgCache;
+  return true;
+}
+static void storeCachedLcg(const std::string& host, uint16_t port, const std::string& path)
+{
+  bool changed = !s_lcgCacheValid || s_lcgCache.host != host || s_lcgCache.port != port || s_lcgCache.path != path;
+
+  s_lcgCache.host       = host;
+  s_lcgCache.port       = port;
+  s_lcgCache.path       = path;
+  s_lcgCache.verifiedAt = 0;
+  s_lcgCacheValid       = true;
+  s_lcgCacheLoaded      = true;
+
+  if (changed && !OpenShock::Config::SetBackendLcgCache(host, port, path)) {
+    OS_LOGW(TAG, "Failed to persist LCG endpoint");
+  }
+}
+static void invalidateCachedLcg()
+{
+  if (!s_lcgCacheValid) {
+    return;
+  }
+
+  OS_LOGD(TAG, "Invalidating cached LCG endpoint");
+
+  s_lcgCacheValid          = false;
+  s_lcgCacheAttemptPending = false;
+  OpenShock::Config::ClearBackendLcgCache();
+}
 
 using namespace OpenShock;
 namespace JsonAPI = OpenShock::Serialization::JsonAPI;
@@ -111,6 +196,18 @@ bool GatewayConnectionManager::IsConnected()
   return client->state() == GatewayClientState::Connected;
 }
 
+bool GatewayConnectionManager::GetLinkQuality(GatewayLinkQuality& out)
+{
+  auto client = GetClient();
+  if (client == nullptr) {
+    return false;
+  }
+
+  out = client->linkQuality();
+
+  return true;
+}
+
 bool GatewayConnectionManager::IsLinked()
 {
   return (s_flags.load(std::memory_order_relaxed) & FLAG_LINKED) != 0;
@@ -157,21 +254,32 @@ AccountLinkResultCode GatewayConnectionManager::Link(std::string_view linkCode)
     return AccountLinkResultCode::InternalError;
   }
 
+  OpenShock::ScopedLock lock__(&s_linkMutex);
+
   if (!Config::SetBackendAuthToken(std::move(response.data.authToken))) {
     OS_LOGE(TAG, "Failed to save auth token");
     return AccountLinkResultCode::InternalError;
   }
 
   s_flags.fetch_or(FLAG_LINKED, std::memory_order_relaxed);
+  s_lcgCacheLoaded = false;
   OS_LOGD(TAG, "Successfully linked to account");
 
   return AccountLinkResultCode::Success;
 }
 void GatewayConnectionManager::UnLink()
 {
+  OpenShock::ScopedLock lock__(&s_linkMutex);
+
   s_flags.fetch_and(static_cast<uint8_t>(~FLAG_LINKED), std::memory_order_relaxed);
   DestroyClient();
   Config::ClearBackendAuthToken();
+  s_lcgCacheLoaded = false;
+
+  // A fetch in flight resets the state itself once it sees the token is gone
+  if (s_hubInfoState != HubInfoState::Fetching) {
+    s_hubInfoState = HubInfoState::Unverified;
+  }
 }
 
 bool GatewayConnectionManager::SendMessageTXT(std::string_view data)
@@ -194,36 +302,35 @@ bool GatewayConnectionManager::SendMessageBIN(tcb::span<const uint8_t> data)
   return client->sendMessageBIN(data);
 }
 
-bool FetchHubInfo(std::string authToken)
+// Only talks to the API, whether the result still applies is decided by applyHubInfoResult
+static HubInfoState FetchHubInfo(std::string authToken)
 {
-  // TODO: this function is very slow, should be optimized!
   if ((s_flags.load(std::memory_order_relaxed) & FLAG_HAS_IP) == 0) {
-    return false;
+    return HubInfoState::Unverified;
   }
 
   if (checkIsDeAuthRateLimited(OpenShock::millis())) {
-    return false;
+    return HubInfoState::Rejected;
   }
 
   auto response = HTTP::JsonAPI::GetHubInfo(std::move(authToken));
 
   if (response.code == 401) {
     OS_LOGD(TAG, "Auth token is invalid, waiting 5 minutes before checking again");
-    s_lastAuthFailure = OpenShock::millis();
-    return false;
+    return HubInfoState::Rejected;
   }
 
   if (response.result == HTTP::RequestResult::RateLimited) {
-    return false;  // Just return false, don't spam the console with errors
+    return HubInfoState::Unverified;  // Just retry later, don't spam the console with errors
   }
   if (response.result != HTTP::RequestResult::Success) {
     OS_LOGE(TAG, "Error while fetching hub info: %s %d", response.ResultToString(), response.code);
-    return false;
+    return HubInfoState::Unverified;
   }
 
   if (response.code != 200) {
     OS_LOGE(TAG, "Unexpected response code: %d", response.code);
-    return false;
+    return HubInfoState::Unverified;
   }
 
   OS_LOGI(TAG, "Hub ID:   %s", response.data.hubId.c_str());
@@ -233,9 +340,75 @@ bool FetchHubInfo(std::string authToken)
     OS_LOGI(TAG, "  [%s] rf=%u model=%u", shocker.id.c_str(), shocker.rfId, shocker.model);
   }
 
-  s_flags.fetch_or(FLAG_LINKED, std::memory_order_relaxed);
+  return HubInfoState::Verified;
+}
 
-  return true;
+// Returns true if authToken was verified and is still the one in use
+static bool applyHubInfoResult(const std::string& authToken, HubInfoState result)
+{
+  OpenShock::ScopedLock lock__(&s_linkMutex);
+
+  // Unlinked or relinked while the request was in flight, the result belongs to a token that is no longer in use
+  std::string currentToken;
+  if (!Config::GetBackendAuthToken(currentToken) || currentToken != authToken) {
+    OS_LOGD(TAG, "Auth token changed while fetching hub info, dropping the result");
+    s_hubInfoState = HubInfoState::Unverified;
+    return false;
+  }
+
+  int64_t msNow = OpenShock::millis();
+  if (result == HubInfoState::Rejected && !checkIsDeAuthRateLimited(msNow)) {
+    s_lastAuthFailure = msNow;
+  }
+  if (result == HubInfoState::Verified) {
+    s_flags.fetch_or(FLAG_LINKED, std::memory_order_relaxed);
+  }
+
+  s_hubInfoState = result;
+
+  return result == HubInfoState::Verified;
+}
+
+static void fetchHubInfoTask(void* arg)
+{
+  {
+    std::unique_ptr<std::string> authToken(static_cast<std::string*>(arg));
+
+    HubInfoState result = FetchHubInfo(*authToken);
+
+    // Broadcast outside the link lock, the captive portal calls Link and UnLink from its own task
+    if (applyHubInfoResult(*authToken, result)) {
+      OS_LOGD(TAG, "Successfully verified auth token");
+      Serialization::Local::SerializeAccountLinkStatusEvent(true, CaptivePortal::BroadcastMessageBIN);
+    }
+  }
+
+  // Never returns, so everything above has to be destroyed first
+  vTaskDelete(nullptr);
+}
+
+static void startFetchingHubInfo()
+{
+  int64_t msNow = OpenShock::millis();
+  if (checkIsHubInfoRateLimited(msNow)) {
+    return;
+  }
+
+  std::string authToken;
+  if (!Config::GetBackendAuthToken(authToken)) {
+    OS_LOGE(TAG, "Failed to get auth token");
+    return;
+  }
+
+  s_lastHubInfoAttempt = msNow;
+  s_hubInfoState       = HubInfoState::Fetching;
+
+  auto arg = new std::string(std::move(authToken));
+  if (TaskUtils::TaskCreateExpensive(fetchHubInfoTask, "HubInfo", 8192, arg, 1, nullptr) != pdPASS) {  // TODO: Profile stack size
+    OS_LOGE(TAG, "Failed to create hub info task");
+    delete arg;
+    s_hubInfoState = HubInfoState::Unverified;
+  }
 }
 
 bool StartConnectingToLCG()
@@ -253,7 +426,26 @@ bool StartConnectingToLCG()
   }
 
   int64_t msNow = OpenShock::millis();
-  if (checkIsDeAuthRateLimited(msNow) || checkIsConnectionRateLimited(msNow)) {
+  if (checkIsDeAuthRateLimited(msNow)) {
+    return false;
+  }
+
+  // Try the last known LCG first, this skips the AssignLcg round-trip and its rate limits
+  const LcgEndpoint* cached = nullptr;
+  if (tryGetCachedLcg(msNow, cached)) {
+    if (checkIsCachedConnectionRateLimited(msNow)) {
+      return false;
+    }
+    s_lastCachedConnectionAttempt = msNow;
+    s_lcgCacheAttemptPending      = true;
+
+    OS_LOGI(TAG, "Connecting to cached LCG endpoint { host: '%s', port: %hu, path: '%s' }", cached->host.c_str(), cached->port, cached->path.c_str());
+    client->connect(cached->host, cached->port, cached->path);
+
+    return true;
+  }
+
+  if (checkIsConnectionRateLimited(msNow)) {
     return false;
   }
   s_lastConnectionAttempt = msNow;
@@ -290,6 +482,9 @@ bool StartConnectingToLCG()
     return false;
   }
 
+  storeCachedLcg(response.data.host, response.data.port, response.data.path);
+  s_lcgCacheAttemptPending = false;
+
   OS_LOGI(TAG, "Connecting to LCG endpoint { host: '%s', port: %hu, path: '%s' } in country %s", response.data.host.c_str(), response.data.port, response.data.path.c_str(), response.data.country.c_str());
   client->connect(response.data.host, response.data.port, response.data.path);
 
@@ -305,33 +500,68 @@ void InitializeClient()
     return;
   }
 
+  if (checkIsDeAuthRateLimited(OpenShock::millis())) {
+    return;
+  }
+
   std::string authToken;
   if (!Config::GetBackendAuthToken(authToken)) {
     OS_LOGE(TAG, "Failed to get auth token");
     return;
   }
 
-  if (!FetchHubInfo(authToken)) {
-    return;
+  // Hub info is verified asynchronously once the socket is up, so it doesn't delay the connection
+  if (s_hubInfoState != HubInfoState::Fetching) {
+    s_hubInfoState = HubInfoState::Unverified;
   }
-
-  s_flags.fetch_or(FLAG_LINKED, std::memory_order_relaxed);
-  OS_LOGD(TAG, "Successfully verified auth token");
-
-  Serialization::Local::SerializeAccountLinkStatusEvent(true, CaptivePortal::BroadcastMessageBIN);
+  s_lcgCacheAttemptPending = false;
 
   CreateClient(authToken);
 }
 
+static void updateConnectedClient(OpenShock::GatewayClient& client)
+{
+  s_lcgCacheAttemptPending = false;
+  if (s_lcgCacheValid && s_lcgCache.verifiedAt == 0) {
+    s_lcgCache.verifiedAt = OpenShock::millis();
+  }
+
+  switch (s_hubInfoState.load()) {
+    case HubInfoState::Unverified:
+      startFetchingHubInfo();
+      break;
+    case HubInfoState::Rejected:
+      OS_LOGW(TAG, "Auth token was rejected, disconnecting from LCG");
+      s_hubInfoState = HubInfoState::Unverified;
+      invalidateCachedLcg();
+      client.disconnect();
+      break;
+    default:
+      break;
+  }
+}
+
 void GatewayConnectionManager::Update()
 {
   auto client = GetClient();
   if (client != nullptr) {
     // Client exists — run its loop and optionally reconnect
-    if (client->loop()) {
+    bool busy = client->loop();
+
+    if (client->state() == GatewayClientState::Connected) {
+      updateConnectedClient(*client);
+    }
+
+    if (busy) {
       return;
     }
 
+    // The cached endpoint never got us connected, fall back to AssignLcg
+    if (s_lcgCacheAttemptPending) {
+      OS_LOGW(TAG, "Failed to connect to cached LCG endpoint");
+      invalidateCachedLcg();
+    }
+
     StartConnectingToLCG();
     return;
   }
@@ -0,0 +1,94 @@
+#include "GatewayLinkQuality.h"
+
+const char* const TAG = "GatewayLinkQuality";
+
+#include "Logging.h"
+
+#include <algorithm>
+#include <limits>
+
+const int64_t PROBE_INTERVAL_US = 10'000'000;  // 10 seconds
+const int64_t PROBE_TIMEOUT_US  = 5'000'000;   // 5 seconds
+
+using namespace OpenShock;
+
+GatewayLinkQualityTracker::GatewayLinkQualityTracker()
+  : m_stats()
+  , m_probeSentAtUs(0)
+  , m_probeEchoId(0)
+  , m_probeOutstanding(false)
+{
+}
+
+bool GatewayLinkQualityTracker::shouldProbe(int64_t nowUs)
+{
+  int64_t elapsed = nowUs - m_probeSentAtUs;
+
+  if (m_probeOutstanding) {
+    if (elapsed < PROBE_TIMEOUT_US) {
+      return false;
+    }
+
+    OS_LOGD(TAG, "Probe %u timed out", m_probeEchoId);
+    m_probeOutstanding = false;
+    m_stats.probesLost++;
+  }
+
+  return m_stats.probesSent == 0 || elapsed >= PROBE_INTERVAL_US;
+}
+
+uint32_t GatewayLinkQualityTracker::onProbeSent(int64_t nowUs)
+{
+  m_probeSentAtUs    = nowUs;
+  m_probeOutstanding = true;
+  m_stats.probesSent++;
+
+  return ++m_probeEchoId;
+}
+
+void GatewayLinkQualityTracker::onProbeAnswered(uint32_t echoId, int64_t nowUs)
+{
+  if (!m_probeOutstanding || echoId != m_probeEchoId) {
+    return;
+  }
+
+  m_probeOutstanding = false;
+
+  int64_t rttUs = nowUs - m_probeSentAtUs;
+  if (rttUs < 0) {
+    return;
+  }
+
+  addSample(static_cast<uint32_t>(std::min<int64_t>(rttUs, std::numeric_limits<uint32_t>::max())));
+}
+
+void GatewayLinkQualityTracker::reset()
+{
+  m_stats            = GatewayLinkQuality {};
+  m_probeSentAtUs    = 0;
+  m_probeOutstanding = false;
+}
+
+void GatewayLinkQualityTracker::addSample(uint32_t rttUs)
+{
+  // Smoothed RTT and RTT variation as described in RFC 6298 (alpha = 1/8, beta = 1/4)
+  if (m_stats.rttEwmaUs == 0) {
+    m_stats.rttEwmaUs   = rttUs;
+    m_stats.rttJitterUs = rttUs / 2;
+  } else {
+    int64_t delta       = static_cast<int64_t>(rttUs) - static_cast<int64_t>(m_stats.rttEwmaUs);
+    int64_t absDelta    = delta < 0 ? -delta : delta;
+    m_stats.rttJitterUs = static_cast<uint32_t>(m_stats.rttJitterUs + (absDelta - static_cast<int64_t>(m_stats.rttJitterUs)) / 4);
+    m_stats.rttEwmaUs   = static_cast<uint32_t>(m_stats.rttEwmaUs + delta / 8);
+  }
+
+  uint32_t rttMs = rttUs / 1000;
+
+  auto bound  = std::upper_bound(GatewayLinkQuality::RTT_BUCKET_BOUNDS_MS.begin(), GatewayLinkQuality::RTT_BUCKET_BOUNDS_MS.end(), rttMs);
+  auto& count = m_stats.rttHistogram[std::distance(GatewayLinkQuality::RTT_BUCKET_BOUNDS_MS.begin(), bound)];
+  if (count < std::numeric_limits<uint16_t>::max()) {
+    count++;
+  }
+
+  OS_LOGV(TAG, "RTT %u us, smoothed %u us, jitter %u us", rttUs, m_stats.rttEwmaUs, m_stats.rttJitterUs);
+}
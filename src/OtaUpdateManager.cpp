@@ -6,6 +6,7 @@ const char* const TAG = "OtaUpdateManager";
 #include "Common.h"
 #include "config/Config.h"
 #include "Core.h"
+#include "events/Events.h"
 #include "GatewayConnectionManager.h"
 #include "Hashing.h"
 #include "http/HTTPRequestManager.h"
@@ -20,11 +21,11 @@ const char* const TAG = "OtaUpdateManager";
 #include "wifi/WiFiManager.h"
 
 #include <esp_ota_ops.h>
-#include <esp_task_wdt.h>
 
 #include <LittleFS.h>
 #include <WiFi.h>
 
+#include <algorithm>
 #include <sstream>
 #include <string_view>
 
@@ -41,9 +42,15 @@ using namespace std::string_view_literals;
 
 #define OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT OPENSHOCK_FW_CDN_BOARDS_BASE_URL_FORMAT "/" OPENSHOCK_FW_BOARD
 
-#define OPENSHOCK_FW_CDN_APP_URL_FORMAT           OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/app.bin"
-#define OPENSHOCK_FW_CDN_FILESYSTEM_URL_FORMAT    OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/staticfs.bin"
-#define OPENSHOCK_FW_CDN_SHA256_HASHES_URL_FORMAT OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/hashes.sha256.txt"
+#define OPENSHOCK_FW_CDN_APP_URL_FORMAT               OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/app.bin"
+#define OPENSHOCK_FW_CDN_FILESYSTEM_URL_FORMAT        OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/staticfs.bin"
+#define OPENSHOCK_FW_CDN_FILESYSTEM_BLOCKS_URL_FORMAT OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/staticfs.blocks.txt"
+#define OPENSHOCK_FW_CDN_SHA256_HASHES_URL_FORMAT     OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/hashes.sha256.txt"
+
+#define OPENSHOCK_FW_CDN_GZIP_SUFFIX ".gz"
+
+#define OPENSHOCK_FW_CDN_APP_DELTA_FILENAME   "app.from-" OPENSHOCK_FW_VERSION ".delta"
+#define OPENSHOCK_FW_CDN_APP_DELTA_URL_FORMAT OPENSHOCK_FW_CDN_VERSION_BASE_URL_FORMAT "/" OPENSHOCK_FW_CDN_APP_DELTA_FILENAME
 
 /// @brief Stops initArduino() from handling OTA rollbacks
 /// @todo Get rid of Arduino entirely. >:(
@@ -59,8 +66,12 @@ enum OtaTaskEventFlag : uint32_t {
   OTA_TASK_EVENT_UPDATE_REQUESTED  = 1 << 0,
   OTA_TASK_EVENT_WIFI_DISCONNECTED = 1 << 1,  // If both connected and disconnected are set, disconnected takes priority.
   OTA_TASK_EVENT_WIFI_CONNECTED    = 1 << 2,
+  OTA_TASK_EVENT_CONFIG_CHANGED    = 1 << 3,
 };
 
+const int64_t OTA_TASK_MIN_SLEEP_MS = 5000;    // Never wakes more often than the old polling interval
+const int64_t OTA_TASK_MAX_SLEEP_MS = 60'000;  // Picks up config changes whose event was dropped from a full event queue
+
 static esp_ota_img_states_t _otaImageState;
 static OpenShock::FirmwareBootType _bootType;
 static TaskHandle_t _taskHandle = nullptr;
@@ -143,6 +154,18 @@ static void otaum_evh_ipevent(void* event_handler_arg, esp_event_base_t event_ba
   }
 }
 
+static void otaum_evh_configchanged(void* event_handler_arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+  (void)event_handler_arg;
+  (void)event_base;
+  (void)event_id;
+
+  auto data = reinterpret_cast<const Config::ChangedEventData*>(event_data);
+  if ((data->sections & Config::SECTION_OTAUPDATE) != 0) {
+    otaum_try_notify_task(OTA_TASK_EVENT_CONFIG_CHANGED);
+  }
+}
+
 static bool otaum_send_progress_msg(Serialization::Types::OtaUpdateProgressTask task, float progress)
 {
   int32_t updateId;
@@ -174,7 +197,7 @@ static bool _sendFailureMessage(std::string_view message, bool fatal = false)
   return true;
 }
 
-static bool otaum_flash_app_partition(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32])
+static bool otaum_flash_app_partition(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], PartitionCompression compression, std::string_view deltaUrl, PartitionCompression deltaCompression)
 {
   OS_LOGD(TAG, "Flashing app partition");
 
@@ -190,7 +213,16 @@ static bool otaum_flash_app_partition(const esp_partition_t* partition, std::str
     return true;
   };
 
-  if (!OpenShock::FlashPartitionFromUrl(partition, remoteUrl, remoteHash, onProgress)) {
+  // Prefer patching the running image, the full image is still there to fall back on
+  bool flashed = false;
+  if (!deltaUrl.empty()) {
+    flashed = OpenShock::FlashPartitionFromUrl(partition, deltaUrl, remoteHash, onProgress, deltaCompression, esp_ota_get_running_partition());
+    if (!flashed) {
+      OS_LOGW(TAG, "Failed to apply delta update, downloading the full app image");
+    }
+  }
+
+  if (!flashed && !OpenShock::FlashPartitionFromUrl(partition, remoteUrl, remoteHash, onProgress, compression)) {
     OS_LOGE(TAG, "Failed to flash app partition");
     _sendFailureMessage("Failed to flash app partition"sv);
     return false;
@@ -210,7 +242,7 @@ static bool otaum_flash_app_partition(const esp_partition_t* partition, std::str
   return true;
 }
 
-static bool otaum_flash_fs_partition(const esp_partition_t* parition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32])
+static bool otaum_flash_fs_partition(const esp_partition_t* parition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], PartitionCompression compression, std::string_view blockHashesUrl)
 {
   if (!otaum_send_progress_msg(Serialization::Types::OtaUpdateProgressTask::PreparingForUpdate, 0.0f)) {
     return false;
@@ -237,7 +269,18 @@ static bool otaum_flash_fs_partition(const esp_partition_t* parition, std::strin
     return true;
   };
 
-  if (!OpenShock::FlashPartitionFromUrl(parition, remoteUrl, remoteHash, onProgress)) {
+  // Only rewrite the blocks that changed, ranges are served from the uncompressed image
+  bool flashed = false;
+  if (!blockHashesUrl.empty()) {
+    std::string_view rawUrl = compression == PartitionCompression::Gzip ? StringRemoveSuffix(remoteUrl, OPENSHOCK_FW_CDN_GZIP_SUFFIX ""sv) : remoteUrl;
+
+    flashed = OpenShock::FlashPartitionBlocksFromUrl(parition, rawUrl, blockHashesUrl, remoteHash, onProgress);
+    if (!flashed) {
+      OS_LOGW(TAG, "Failed to update changed filesystem blocks, downloading the full image");
+    }
+  }
+
+  if (!flashed && !OpenShock::FlashPartitionFromUrl(parition, remoteUrl, remoteHash, onProgress, compression)) {
     OS_LOGE(TAG, "Failed to flash filesystem partition");
     _sendFailureMessage("Failed to flash filesystem partition"sv);
     return false;
@@ -259,12 +302,30 @@ static bool otaum_flash_fs_partition(const esp_partition_t* parition, std::strin
   return true;
 }
 
-static void otaum_restore_wdt_timeout()
+// How long the update loop can sleep before a check is due, events wake it earlier
+static TickType_t otaum_next_check_delay(bool connected, bool configStale, const Config::OtaUpdateConfig& config, bool updateRequested, int64_t lastUpdateCheck)
 {
-  if (esp_task_wdt_init(5, true) != ESP_OK) {
-    OS_LOGE(TAG, "Failed to restore task watchdog timeout");
+  if (!connected) {
+    return portMAX_DELAY;
+  }
+
+  if (configStale) {
+    return pdMS_TO_TICKS(OTA_TASK_MIN_SLEEP_MS);  // Retry reading the config
   }
-};
+
+  // Even with nothing scheduled, wake up now and then to compare the config generation
+  int64_t deadline = INT64_MAX;
+  if (config.isEnabled && config.checkPeriodically) {
+    deadline = lastUpdateCheck + config.checkInterval * 60'000LL;
+  }
+  if (config.isEnabled && updateRequested) {
+    deadline = std::min(deadline, lastUpdateCheck + 60'000LL);
+  }
+
+  int64_t remaining = std::clamp(deadline - OpenShock::millis(), OTA_TASK_MIN_SLEEP_MS, OTA_TASK_MAX_SLEEP_MS);
+
+  return pdMS_TO_TICKS(static_cast<uint32_t>(remaining));
+}
 
 static void otaum_updatetask(void* arg)
 {
@@ -276,13 +337,20 @@ static void otaum_updatetask(void* arg)
   bool updateRequested    = false;
   int64_t lastUpdateCheck = 0;
 
+  // Local copy, only re-read when the config changes
+  Config::OtaUpdateConfig config;
+  uint32_t configGeneration = 0;
+  bool configStale          = true;
+
   // Update task loop.
   while (true) {
-    // Wait for event.
+    // Wait for event, or until the next check is due.
     uint32_t eventBits = 0;
-    xTaskNotifyWait(0, UINT32_MAX, &eventBits, pdMS_TO_TICKS(5000));  // TODO: wait for rest time
+    xTaskNotifyWait(0, UINT32_MAX, &eventBits, otaum_next_check_delay(connected, configStale, config, updateRequested, lastUpdateCheck));
 
     updateRequested |= (eventBits & OTA_TASK_EVENT_UPDATE_REQUESTED) != 0;
+    configStale |= (eventBits & OTA_TASK_EVENT_CONFIG_CHANGED) != 0;
+    configStale |= Config::GetGeneration() != configGeneration;  // The change event is dropped when the event queue is full
 
     if ((eventBits & OTA_TASK_EVENT_WIFI_DISCONNECTED) != 0) {
       OS_LOGD(TAG, "WiFi disconnected");
@@ -302,10 +370,15 @@ static void otaum_updatetask(void* arg)
 
     int64_t now = OpenShock::millis();
 
-    Config::OtaUpdateConfig config;
-    if (!Config::GetOtaUpdateConfig(config)) {
-      OS_LOGE(TAG, "Failed to get OTA update config");
-      continue;
+    if (configStale) {
+      // Taken before reading the config, so a change made in between is picked up on the next wake-up
+      uint32_t generation = Config::GetGeneration();
+      if (!Config::GetOtaUpdateConfig(config)) {
+        OS_LOGE(TAG, "Failed to get OTA update config");
+        continue;
+      }
+      configGeneration = generation;
+      configStale      = false;
     }
 
     if (!config.isEnabled) {
@@ -394,6 +467,7 @@ static void otaum_updatetask(void* arg)
     OS_LOGD(TAG, "  Version:                %.*s", versionStr.length(), versionStr.data());
     OS_LOGD(TAG, "  App binary URL:         %.*s", release.appBinaryUrl.length(), release.appBinaryUrl.data());
     OS_LOGD(TAG, "  App binary hash:        %s", HexUtils::ToHex<32>(release.appBinaryHash).data());
+    OS_LOGD(TAG, "  App delta URL:          %.*s", release.appBinaryDeltaUrl.length(), release.appBinaryDeltaUrl.data());
     OS_LOGD(TAG, "  Filesystem binary URL:  %.*s", release.filesystemBinaryUrl.length(), release.filesystemBinaryUrl.data());
     OS_LOGD(TAG, "  Filesystem binary hash: %s", HexUtils::ToHex<32>(release.filesystemBinaryHash).data());
 
@@ -413,35 +487,26 @@ static void otaum_updatetask(void* arg)
       continue;
     }
 
-    // Increase task watchdog timeout.
-    // Prevents panics on some ESP32s when clearing large partitions.
-    if (esp_task_wdt_init(15, true) != ESP_OK) {
-      OS_LOGE(TAG, "Failed to increase task watchdog timeout");
-      _sendFailureMessage("Failed to increase task watchdog timeout"sv);
-      continue;
-    }
+    int64_t flashBegin = OpenShock::millis();
 
     // Flash app and filesystem partitions.
-    if (!otaum_flash_fs_partition(filesystemPartition, release.filesystemBinaryUrl, release.filesystemBinaryHash)) {
-      otaum_restore_wdt_timeout();
+    // Partitions are erased incrementally while writing, so no watchdog adjustments are needed for large erases.
+    if (!otaum_flash_fs_partition(filesystemPartition, release.filesystemBinaryUrl, release.filesystemBinaryHash, release.filesystemBinaryCompression, release.filesystemBlockHashesUrl)) {
       continue;
     }
-    if (!otaum_flash_app_partition(appPartition, release.appBinaryUrl, release.appBinaryHash)) {
-      otaum_restore_wdt_timeout();
+    if (!otaum_flash_app_partition(appPartition, release.appBinaryUrl, release.appBinaryHash, release.appBinaryCompression, release.appBinaryDeltaUrl, release.appBinaryDeltaCompression)) {
       continue;
     }
 
+    OS_LOGI(TAG, "Flashed firmware in %lld ms", OpenShock::millis() - flashBegin);
+
     // Set OTA boot type in config.
     if (!Config::SetOtaUpdateStep(OpenShock::OtaUpdateStep::Updated)) {
       OS_LOGE(TAG, "Failed to set OTA update step");
       _sendFailureMessage("Failed to set OTA update step"sv);
-      otaum_restore_wdt_timeout();
       continue;
     }
 
-    // Set task watchdog timeout back to default.
-    otaum_restore_wdt_timeout();
-
     // Send reboot message.
     otaum_send_progress_msg(Serialization::Types::OtaUpdateProgressTask::Rebooting, 0.0f);
 
@@ -457,7 +522,7 @@ static void otaum_updatetask(void* arg)
 
 static bool _tryGetStringList(std::string_view url, std::vector<std::string>& list)
 {
-  auto response = OpenShock::HTTP::GetString(
+  auto response = OpenShock::HTTP::GetStringCached(
     url,
     {
       {"Accept", "text/plain"}
@@ -556,6 +621,12 @@ bool OtaUpdateManager::Init()
     return false;
   }
 
+  err = esp_event_handler_register(OPENSHOCK_EVENTS, OPENSHOCK_EVENT_CONFIG_CHANGED, otaum_evh_configchanged, nullptr);
+  if (err != ESP_OK) {
+    OS_LOGE(TAG, "Failed to register event handler for OPENSHOCK_EVENTS: %s", esp_err_to_name(err));
+    return false;
+  }
+
   return true;
 }
 
@@ -579,7 +650,7 @@ bool OtaUpdateManager::TryGetFirmwareVersion(OtaUpdateChannel channel, OpenShock
 
   OS_LOGD(TAG, "Fetching firmware version from %s", channelIndexUrl);
 
-  auto response = OpenShock::HTTP::GetString(
+  auto response = OpenShock::HTTP::GetStringCached(
     channelIndexUrl,
     {
       {"Accept", "text/plain"}
@@ -649,7 +720,7 @@ bool OtaUpdateManager::TryGetFirmwareRelease(const OpenShock::SemVer& version, F
   }
 
   // Fetch hashes.
-  auto sha256HashesResponse = OpenShock::HTTP::GetString(
+  auto sha256HashesResponse = OpenShock::HTTP::GetStringCached(
     sha256HashesUrl,
     {
       {"Accept", "text/plain"}
@@ -663,6 +734,14 @@ bool OtaUpdateManager::TryGetFirmwareRelease(const OpenShock::SemVer& version, F
 
   auto hashesLines = OpenShock::StringSplitNewLines(sha256HashesResponse.data);
 
+  release.appBinaryCompression        = PartitionCompression::None;
+  release.filesystemBinaryCompression = PartitionCompression::None;
+  release.appBinaryDeltaCompression   = PartitionCompression::None;
+  release.appBinaryDeltaUrl.clear();
+  release.filesystemBlockHashesUrl.clear();
+
+  bool foundAppDelta = false, foundFilesystemBlocks = false;
+
   // Parse hashes.
   bool foundAppHash = false, foundFilesystemHash = false;
   for (std::string_view line : hashesLines) {
@@ -704,6 +783,19 @@ bool OtaUpdateManager::TryGetFirmwareRelease(const OpenShock::SemVer& version, F
       }
 
       foundFilesystemHash = true;
+    } else if (file == "app.bin" OPENSHOCK_FW_CDN_GZIP_SUFFIX) {
+      // Only advertises the compressed artifact, the image is verified against the app.bin hash after inflating
+      release.appBinaryCompression = PartitionCompression::Gzip;
+    } else if (file == "staticfs.bin" OPENSHOCK_FW_CDN_GZIP_SUFFIX) {
+      release.filesystemBinaryCompression = PartitionCompression::Gzip;
+    } else if (file == OPENSHOCK_FW_CDN_APP_DELTA_FILENAME) {
+      // Patches are checked against the app.bin hash once applied
+      foundAppDelta = true;
+    } else if (file == OPENSHOCK_FW_CDN_APP_DELTA_FILENAME OPENSHOCK_FW_CDN_GZIP_SUFFIX) {
+      foundAppDelta                     = true;
+      release.appBinaryDeltaCompression = PartitionCompression::Gzip;
+    } else if (file == "staticfs.blocks.txt") {
+      foundFilesystemBlocks = true;
     }
   }
 
@@ -717,6 +809,30 @@ bool OtaUpdateManager::TryGetFirmwareRelease(const OpenShock::SemVer& version, F
     return false;
   }
 
+  if (release.appBinaryCompression == PartitionCompression::Gzip) {
+    release.appBinaryUrl.append(OPENSHOCK_FW_CDN_GZIP_SUFFIX);
+  }
+
+  if (release.filesystemBinaryCompression == PartitionCompression::Gzip) {
+    release.filesystemBinaryUrl.append(OPENSHOCK_FW_CDN_GZIP_SUFFIX);
+  }
+
+  if (foundAppDelta) {
+    if (!FormatToString(release.appBinaryDeltaUrl, OPENSHOCK_FW_CDN_APP_DELTA_URL_FORMAT, versionStr.c_str())) {
+      OS_LOGE(TAG, "Failed to format URL");
+      return false;
+    }
+
+    if (release.appBinaryDeltaCompression == PartitionCompression::Gzip) {
+      release.appBinaryDeltaUrl.append(OPENSHOCK_FW_CDN_GZIP_SUFFIX);
+    }
+  }
+
+  if (foundFilesystemBlocks && !FormatToString(release.filesystemBlockHashesUrl, OPENSHOCK_FW_CDN_FILESYSTEM_BLOCKS_URL_FORMAT, versionStr.c_str())) {
+    OS_LOGE(TAG, "Failed to format URL");
+    return false;
+  }
+
   return true;
 }
 
@@ -11,9 +11,10 @@ const char* const TAG = "RateLimiter";
 OpenShock::RateLimiter::RateLimiter()
   : m_mutex()
   , m_nextSlot(0)
-  , m_nextCleanup(0)
   , m_limits()
   , m_requests()
+  , m_requestHead(0)
+  , m_requestCount(0)
 {
 }
 
@@ -28,8 +29,11 @@ void OpenShock::RateLimiter::addLimit(uint32_t durationMs, uint16_t count)
   // Insert sorted
   m_limits.insert(std::upper_bound(m_limits.begin(), m_limits.end(), durationMs, [](int64_t durationMs, const Limit& limit) { return durationMs < limit.durationMs; }), {durationMs, count});
 
-  m_nextSlot    = 0;
-  m_nextCleanup = 0;
+  // The ring only has to remember as many requests as the largest window may hold
+  std::size_t capacity = std::max_element(m_limits.begin(), m_limits.end(), [](const Limit& a, const Limit& b) { return a.count < b.count; })->count;
+  m_requests.assign(capacity, 0);
+
+  resetRequests();
 }
 
 void OpenShock::RateLimiter::clearLimits()
@@ -37,8 +41,9 @@ void OpenShock::RateLimiter::clearLimits()
   OpenShock::ScopedLock lock__(&m_mutex);
 
   m_limits.clear();
-  m_nextSlot    = 0;
-  m_nextCleanup = 0;
+  m_requests.clear();
+
+  resetRequests();
 }
 
 bool OpenShock::RateLimiter::tryRequest()
@@ -50,27 +55,6 @@ bool OpenShock::RateLimiter::tryRequest()
   if (m_limits.empty()) {
     return true;
   }
-  if (m_requests.empty()) {
-    m_requests.push_back(now);
-    return true;
-  }
-
-  // Cleanup based on longest limit
-  if (m_nextCleanup <= now) {
-    int64_t longestLimit = m_limits.back().durationMs;
-    int64_t expiresAt    = now - longestLimit;
-
-    // erase everything that’s expired
-    auto firstAlive = std::upper_bound(m_requests.begin(), m_requests.end(), expiresAt);
-    m_requests.erase(m_requests.begin(), firstAlive);
-
-    if (!m_requests.empty()) {
-      m_nextCleanup = m_requests.front() + longestLimit;
-    } else {
-      // nothing to clean until we add a new request
-      m_nextCleanup = now + longestLimit;
-    }
-  }
 
   if (m_nextSlot > now) {
     return false;
@@ -80,38 +64,38 @@ bool OpenShock::RateLimiter::tryRequest()
   for (std::size_t i = m_limits.size(); i > 0;) {
     const auto& limit = m_limits[--i];
 
-    // Calculate the window start time
-    int64_t windowStart = now - limit.durationMs;
-
-    // Check how many requests are inside the limit window and track earliest in-window element
-    std::size_t insideWindow = 0;
-    auto it                  = m_requests.rbegin();
-    for (; it != m_requests.rend(); ++it) {
-      if (*it < windowStart) break;
-      ++insideWindow;
+    if (limit.count == 0) {
+      return false;
     }
 
-    // If the window is full, set the wait time until its available, and reject the request
-    if (insideWindow >= limit.count) {
-      auto firstInWindow = (it == m_requests.rend()) ? m_requests.begin() : it.base();
+    if (m_requestCount < limit.count) {
+      continue;
+    }
 
-      m_nextSlot = *firstInWindow + limit.durationMs;
+    // The window is full if the count-th most recent request is still inside it
+    int64_t nthLatest = m_requests[(m_requestHead + m_requests.size() - limit.count) % m_requests.size()];
+    if (nthLatest >= now - limit.durationMs) {
+      // Set the wait time until a slot frees up, and reject the request
+      m_nextSlot = nthLatest + limit.durationMs;
       return false;
     }
   }
 
   // Add the request
-  m_requests.push_back(now);
+  if (!m_requests.empty()) {
+    m_requests[m_requestHead] = now;
+    m_requestHead             = (m_requestHead + 1) % m_requests.size();
+    m_requestCount            = std::min(m_requestCount + 1, m_requests.size());
+  }
 
   return true;
 }
+
 void OpenShock::RateLimiter::clearRequests()
 {
   OpenShock::ScopedLock lock__(&m_mutex);
 
-  m_requests.clear();
-  m_nextSlot    = 0;
-  m_nextCleanup = 0;
+  resetRequests();
 }
 
 void OpenShock::RateLimiter::blockFor(int64_t blockForMs)
@@ -121,3 +105,10 @@ void OpenShock::RateLimiter::blockFor(int64_t blockForMs)
   int64_t blockUntil = OpenShock::millis() + blockForMs;
   m_nextSlot         = std::max(m_nextSlot, blockUntil);
 }
+
+void OpenShock::RateLimiter::resetRequests()
+{
+  m_nextSlot     = 0;
+  m_requestHead  = 0;
+  m_requestCount = 0;
+}
@@ -6,65 +6,212 @@ const char* const TAG = "ReadWriteMutex";
 
 #include "Logging.h"
 
-OpenShock::ReadWriteMutex::ReadWriteMutex()
-  : m_mutex(xSemaphoreCreateMutex())
-  , m_readSem(xSemaphoreCreateBinary())
-  , m_readers(0)
+#include <esp_timer.h>
+
+const uint32_t WRITER_BIT   = 1U << 31;
+const EventBits_t GATE_OPEN = 1 << 0;
+
+using namespace OpenShock;
+
+// Ticks left of a wait that started at start, false once it has run out
+static bool remainingTicks(TickType_t start, TickType_t xTicksToWait, TickType_t& remaining)
 {
-  xSemaphoreGive(m_readSem);
+  if (xTicksToWait == portMAX_DELAY) {
+    remaining = portMAX_DELAY;
+    return true;
+  }
+
+  TickType_t elapsed = xTaskGetTickCount() - start;
+  if (elapsed >= xTicksToWait) {
+    return false;
+  }
+
+  remaining = xTicksToWait - elapsed;
+  return true;
 }
 
-OpenShock::ReadWriteMutex::~ReadWriteMutex()
+ReadWriteMutex::ReadWriteMutex()
+  : m_state(0)
+  , m_writeMutex(xSemaphoreCreateMutex())
+  , m_drained(xSemaphoreCreateBinary())
+  , m_gate(xEventGroupCreate())
+  , m_waitingReaders(0)
+  , m_readContentions(0)
+  , m_writeContentions(0)
+  , m_timeouts(0)
+  , m_readWaitUs(0)
+  , m_writeWaitUs(0)
+  , m_maxWriteWaitUs(0)
 {
-  vSemaphoreDelete(m_mutex);
-  vSemaphoreDelete(m_readSem);
+  xEventGroupSetBits(m_gate, GATE_OPEN);
 }
 
-bool OpenShock::ReadWriteMutex::lockRead(TickType_t xTicksToWait)
+ReadWriteMutex::~ReadWriteMutex()
 {
-  if (xSemaphoreTake(m_readSem, xTicksToWait) == pdFALSE) {
-    OS_LOGE(TAG, "Failed to take read semaphore");
-    return false;
-  }
+  vSemaphoreDelete(m_writeMutex);
+  vSemaphoreDelete(m_drained);
+  vEventGroupDelete(m_gate);
+}
 
-  if (++m_readers == 1) {
-    if (xSemaphoreTake(m_mutex, xTicksToWait) == pdFALSE) {
-      --m_readers;
-      xSemaphoreGive(m_readSem);
-      return false;
+bool ReadWriteMutex::tryEnterRead()
+{
+  uint32_t state = m_state.load(std::memory_order_relaxed);
+  while ((state & WRITER_BIT) == 0) {
+    if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return true;
     }
   }
 
-  xSemaphoreGive(m_readSem);
-
-  return true;
+  return false;
 }
 
-void OpenShock::ReadWriteMutex::unlockRead()
+void ReadWriteMutex::recordWait(bool write, int64_t beginUs)
 {
-  if (xSemaphoreTake(m_readSem, portMAX_DELAY) == pdFALSE) {
-    OS_LOGE(TAG, "Failed to take read semaphore");
+  uint32_t waitUs = static_cast<uint32_t>(esp_timer_get_time() - beginUs);
+
+  if (!write) {
+    m_readContentions.fetch_add(1, std::memory_order_relaxed);
+    m_readWaitUs.fetch_add(waitUs, std::memory_order_relaxed);
     return;
   }
 
-  if (--m_readers == 0) {
-    xSemaphoreGive(m_mutex);
+  m_writeContentions.fetch_add(1, std::memory_order_relaxed);
+  m_writeWaitUs.fetch_add(waitUs, std::memory_order_relaxed);
+
+  // Only the writer holding the lock gets here, so there is no competing update
+  if (waitUs > m_maxWriteWaitUs.load(std::memory_order_relaxed)) {
+    m_maxWriteWaitUs.store(waitUs, std::memory_order_relaxed);
+  }
+}
+
+bool ReadWriteMutex::lockRead(TickType_t xTicksToWait)
+{
+  if (tryEnterRead()) {
+    return true;
   }
 
-  xSemaphoreGive(m_readSem);
+  int64_t beginUs  = esp_timer_get_time();
+  TickType_t start = xTaskGetTickCount();
+
+  // Counted readers are let in before the next writer may close the gate again
+  m_waitingReaders.fetch_add(1, std::memory_order_acq_rel);
+
+  while (true) {
+    if (tryEnterRead()) {
+      leaveWaitingReaders();
+      recordWait(false, beginUs);
+      return true;
+    }
+
+    TickType_t remaining;
+    if (!remainingTicks(start, xTicksToWait, remaining)) {
+      leaveWaitingReaders();
+      m_timeouts.fetch_add(1, std::memory_order_relaxed);
+      OS_LOGE(TAG, "Timed out waiting for read lock");
+      return false;
+    }
+
+    xEventGroupWaitBits(m_gate, GATE_OPEN, pdFALSE, pdTRUE, remaining);
+  }
 }
 
-bool OpenShock::ReadWriteMutex::lockWrite(TickType_t xTicksToWait)
+void ReadWriteMutex::leaveWaitingReaders()
 {
-  if (xSemaphoreTake(m_mutex, xTicksToWait) == pdFALSE) {
-    OS_LOGE(TAG, "Failed to take mutex");
-    return false;
+  // Last queued reader in, a writer may be waiting for that
+  if (m_waitingReaders.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    xSemaphoreGive(m_drained);
+  }
+}
+
+void ReadWriteMutex::unlockRead()
+{
+  uint32_t state = m_state.fetch_sub(1, std::memory_order_release) - 1;
+
+  // Last reader out while a writer waits
+  if (state == WRITER_BIT) {
+    xSemaphoreGive(m_drained);
+  }
+}
+
+bool ReadWriteMutex::lockWrite(TickType_t xTicksToWait)
+{
+  int64_t beginUs  = esp_timer_get_time();
+  TickType_t start = xTaskGetTickCount();
+  bool contended   = false;
+
+  if (xSemaphoreTake(m_writeMutex, 0) == pdFALSE) {
+    contended = true;
+
+    if (xSemaphoreTake(m_writeMutex, xTicksToWait) == pdFALSE) {
+      m_timeouts.fetch_add(1, std::memory_order_relaxed);
+      OS_LOGE(TAG, "Timed out waiting for write lock");
+      return false;
+    }
+  }
+
+  // Readers that queued up behind the previous writer get their turn first, otherwise back-to-back writers could starve them
+  while (m_waitingReaders.load(std::memory_order_acquire) > 0) {
+    contended = true;
+
+    TickType_t remaining;
+    if (!remainingTicks(start, xTicksToWait, remaining)) {
+      xSemaphoreGive(m_writeMutex);
+
+      m_timeouts.fetch_add(1, std::memory_order_relaxed);
+      OS_LOGE(TAG, "Timed out waiting for queued readers");
+      return false;
+    }
+
+    xSemaphoreTake(m_drained, remaining);
+  }
+
+  // Close the gate before announcing the writer, so readers that see the bit always find it closed
+  xEventGroupClearBits(m_gate, GATE_OPEN);
+  uint32_t state = m_state.fetch_or(WRITER_BIT, std::memory_order_acq_rel) | WRITER_BIT;
+
+  // No new readers get in now, wait for the ones inside to leave
+  while (state != WRITER_BIT) {
+    contended = true;
+
+    TickType_t remaining;
+    if (!remainingTicks(start, xTicksToWait, remaining)) {
+      m_state.fetch_and(~WRITER_BIT, std::memory_order_release);
+      xEventGroupSetBits(m_gate, GATE_OPEN);
+      xSemaphoreGive(m_writeMutex);
+
+      m_timeouts.fetch_add(1, std::memory_order_relaxed);
+      OS_LOGE(TAG, "Timed out waiting for readers to leave");
+      return false;
+    }
+
+    // A give left over from an earlier writer or from the queued readers only causes an extra check
+    xSemaphoreTake(m_drained, remaining);
+
+    state = m_state.load(std::memory_order_acquire);
+  }
+
+  if (contended) {
+    recordWait(true, beginUs);
   }
 
   return true;
 }
 
-void OpenShock::ReadWriteMutex::unlockWrite()
+void ReadWriteMutex::unlockWrite()
+{
+  m_state.fetch_and(~WRITER_BIT, std::memory_order_release);
+  xEventGroupSetBits(m_gate, GATE_OPEN);
+  xSemaphoreGive(m_writeMutex);
+}
+
+ReadWriteMutex::Metrics ReadWriteMutex::getMetrics() const
 {
-  xSemaphoreGive(m_mutex);
+  return {
+    .readContentions  = m_readContentions.load(std::memory_order_relaxed),
+    .writeContentions = m_writeContentions.load(std::memory_order_relaxed),
+    .timeouts         = m_timeouts.load(std::memory_order_relaxed),
+    .readWaitUs       = m_readWaitUs.load(std::memory_order_relaxed),
+    .writeWaitUs      = m_writeWaitUs.load(std::memory_order_relaxed),
+    .maxWriteWaitUs   = m_maxWriteWaitUs.load(std::memory_order_relaxed),
+  };
 }
@@ -4,14 +4,20 @@ const char* const TAG = "WebSocketDeFragger";
 
 #include "Logging.h"
 
+#include <algorithm>
 #include <cstring>
 
 using namespace OpenShock;
 
-WebSocketDeFragger::WebSocketDeFragger(EventCallback callback)
-  : m_messages()
+WebSocketDeFragger::WebSocketDeFragger(EventCallback callback, uint32_t maxMessageSize)
+  : m_slots()
+  , m_maxMessageSize(maxMessageSize)
   , m_callback(callback)
 {
+  for (auto& slot : m_slots) {
+    slot.type  = WebSocketMessageType::Binary;
+    slot.state = SlotState::Idle;
+  }
 }
 
 WebSocketDeFragger::~WebSocketDeFragger()
@@ -64,6 +70,11 @@ void WebSocketDeFragger::handler(uint8_t socketId, WStype_t type, const uint8_t*
       return;
   }
 
+  if ((messageType == WebSocketMessageType::Text || messageType == WebSocketMessageType::Binary) && length > m_maxMessageSize) {
+    OS_LOGE(TAG, "WebSocket client #%u sent a %u byte message, exceeding the %u byte limit", socketId, length, m_maxMessageSize);
+    return;
+  }
+
   m_callback(socketId, messageType, tcb::span<const uint8_t>(payload, length));
 }
 
@@ -74,52 +85,83 @@ void WebSocketDeFragger::onEvent(const EventCallback& callback)
 
 void WebSocketDeFragger::clear(uint8_t socketId)
 {
-  auto it = m_messages.find(socketId);
-  if (it != m_messages.end()) {
-    it->second.data.clear();
-    m_messages.erase(it);
+  if (socketId >= MAX_SOCKETS) {
+    return;
   }
+
+  auto& slot = m_slots[socketId];
+  slot.data.clear();
+  slot.state = SlotState::Idle;
 }
 
 void WebSocketDeFragger::clear()
 {
-  m_messages.clear();
+  for (auto& slot : m_slots) {
+    slot.data.clear();
+    slot.state = SlotState::Idle;
+  }
+}
+
+bool WebSocketDeFragger::appendToSlot(uint8_t socketId, Slot& slot, const uint8_t* data, uint32_t length)
+{
+  if (slot.state != SlotState::Receiving) {
+    return false;
+  }
+
+  uint32_t size = slot.data.size();
+  if (length > m_maxMessageSize - size) {
+    OS_LOGE(TAG, "WebSocket client #%u fragmented message exceeds %u bytes, discarding", socketId, m_maxMessageSize);
+    slot.data.clear();
+    slot.state = SlotState::Discarding;
+    return false;
+  }
+
+  uint32_t needed = size + length;
+  if (needed > slot.data.capacity()) {
+    // Grow geometrically, but never past the message cap
+    slot.data.reserve(std::min(std::max(needed, slot.data.capacity() * 2), m_maxMessageSize));
+  }
+
+  slot.data.append(data, length);
+
+  return true;
 }
 
 void WebSocketDeFragger::start(uint8_t socketId, WebSocketMessageType type, const uint8_t* data, uint32_t length)
 {
-  auto it = m_messages.find(socketId);
-  if (it != m_messages.end()) {
-    it->second.data.assign(data, length);
-    it->second.type = type;
+  if (socketId >= MAX_SOCKETS) {
+    OS_LOGE(TAG, "WebSocket client #%u is out of range", socketId);
     return;
   }
 
-  m_messages.insert(std::make_pair(socketId, Message {.data = TinyVec<uint8_t>(data, length), .type = type}));
+  auto& slot = m_slots[socketId];
+  slot.data.clear();
+  slot.type  = type;
+  slot.state = SlotState::Receiving;
+
+  appendToSlot(socketId, slot, data, length);
 }
 
 void WebSocketDeFragger::append(uint8_t socketId, const uint8_t* data, uint32_t length)
 {
-  auto it = m_messages.find(socketId);
-  if (it == m_messages.end()) {
+  if (socketId >= MAX_SOCKETS) {
     return;
   }
 
-  it->second.data.append(data, length);
+  appendToSlot(socketId, m_slots[socketId], data, length);
 }
 
 void WebSocketDeFragger::finish(uint8_t socketId, const uint8_t* data, uint32_t length)
 {
-  auto it = m_messages.find(socketId);
-  if (it == m_messages.end()) {
+  if (socketId >= MAX_SOCKETS) {
     return;
   }
 
-  auto& message = it->second;
-  message.data.append(data, length);
-
-  m_callback(socketId, message.type, message.data);
+  auto& slot = m_slots[socketId];
+  if (appendToSlot(socketId, slot, data, length)) {
+    m_callback(socketId, slot.type, tcb::span<const uint8_t>(slot.data.data(), slot.data.size()));
+  }
 
-  message.data.clear();
-  m_messages.erase(it);
+  slot.data.clear();
+  slot.state = SlotState::Idle;
 }
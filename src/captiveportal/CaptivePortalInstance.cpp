@@ -94,7 +94,7 @@ static const char* getPartitionHash()
 CaptivePortal::CaptivePortalInstance::CaptivePortalInstance()
   : m_webServer(HTTP_PORT)
   , m_socketServer(WEBSOCKET_PORT, "/ws", "flatbuffers")  // Sec-WebSocket-Protocol = flatbuffers
-  , m_socketDeFragger(std::bind(&CaptivePortalInstance::handleWebSocketEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3))
+  , m_socketDeFragger(std::bind(&CaptivePortalInstance::handleWebSocketEvent, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), MessageHandlers::WebSocket::LOCAL_MAX_MESSAGE_SIZE)
   , m_fileSystem()
   , m_dnsServer()
   , m_taskHandle(nullptr)
@@ -7,22 +7,70 @@ const char* const TAG = "Config";
 #include "Chipset.h"
 #include "Common.h"
 #include "config/RootConfig.h"
+#include "Core.h"
+#include "events/Events.h"
 #include "Logging.h"
 #include "ReadWriteMutex.h"
+#include "util/TaskUtils.h"
+
+#include <esp_rom_crc.h>
+#include <esp_system.h>
 
 #include <FS.h>
 #include <LittleFS.h>
 
 #include <cJSON.h>
 
+#include <atomic>
 #include <bitset>
+#include <cstring>
+#include <memory>
 
 using namespace OpenShock;
 
+const char* const LCG_CACHE_FILE = "/lcgCache";
+const uint8_t LCG_CACHE_VERSION  = 1;
+const std::size_t LCG_CACHE_MAX  = 256;
+
+const char* const OTA_RESUME_FILE = "/otaResume";
+const uint8_t OTA_RESUME_VERSION  = 1;
+const std::size_t OTA_RESUME_MAX  = 512;
+
+const char* const HTTP_CACHE_FILE_PREFIX = "/httpCache";
+const uint8_t HTTP_CACHE_VERSION         = 1;
+const std::size_t HTTP_CACHE_SLOTS       = 4;  // Channel version, board list and release hashes, plus one spare
+const std::size_t HTTP_CACHE_HEADER_SIZE = 5;
+const std::size_t HTTP_CACHE_MAX         = 8 * 1024;
+
+const char* const CONFIG_TEMP_FILE              = "/config.tmp";
+const char* const CONFIG_LOG_FILE               = "/configLog";
+const uint8_t CONFIG_LOG_VERSION                = 1;
+const std::size_t CONFIG_LOG_HEADER_SIZE        = 5;     // u8 version, u32 CRC-32 of the config file the log applies to
+const std::size_t CONFIG_LOG_RECORD_HEADER_SIZE = 7;     // u8 section index, u16 payload length, u32 CRC-32 of the index, length and payload
+const std::size_t CONFIG_LOG_MAX                = 4096;  // Compacted into the config file once it would grow past this
+
+const uint32_t CONFIG_FLUSH_DELAY_MS     = 2000;   // Quiet time after the last change before it is written
+const uint32_t CONFIG_FLUSH_MAX_DELAY_MS = 10'000;  // Upper bound on how long a steady stream of changes can hold back a write
+const uint32_t CONFIG_SHUTDOWN_LOCK_MS   = 500;     // Longest the restart path waits for the config lock
+
 static fs::LittleFSFS _configFS;
 static Config::RootConfig _configData;
 static ReadWriteMutex _configMutex;
 
+// Guarded by _configMutex
+static uint8_t _configDirtySections = 0;
+static uint32_t _configPendingSaves = 0;
+static std::size_t _configLogSize   = 0;      // 0 while there is no log
+static bool _configLogTorn          = false;  // An append failed partway, nothing may follow it in the log
+static uint32_t _configFileCrc      = 0;
+static Config::PersistMetrics _configMetrics {};
+
+// Immutable copy of _configData handed to readers, replaced as a whole after every change
+static std::shared_ptr<const Config::RootConfig> _configSnapshot;
+static std::atomic<uint32_t> _configGeneration = 0;
+
+static TaskHandle_t _configFlushTaskHandle = nullptr;
+
 #define CONFIG_LOCK_READ_ACTION(retval, action)  \
   ScopedReadLock lock__(&_configMutex);          \
   if (!lock__.isLocked()) {                      \
@@ -42,6 +90,14 @@ static ReadWriteMutex _configMutex;
 #define CONFIG_LOCK_READ(retval)  CONFIG_LOCK_READ_ACTION(retval, {})
 #define CONFIG_LOCK_WRITE(retval) CONFIG_LOCK_WRITE_ACTION(retval, {})
 
+// Pins the current snapshot as `config`, readers never take the lock and never block writers
+#define CONFIG_SNAPSHOT(retval)                           \
+  auto config = std::atomic_load(&_configSnapshot);       \
+  if (config == nullptr) {                                \
+    OS_LOGE(TAG, "Config accessed before it was loaded"); \
+    return retval;                                        \
+  }
+
 static bool tryDeserializeConfig(const uint8_t* buffer, std::size_t bufferLen, OpenShock::Config::RootConfig& config)
 {
   if (buffer == nullptr || bufferLen < sizeof(flatbuffers::uoffset_t)) {
@@ -94,6 +150,15 @@ static bool tryLoadConfig(TinyVec<uint8_t>& buffer)
 
   return true;
 }
+static uint32_t readU32(const uint8_t* data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+// The log records which file it applies to by this CRC
+static void setConfigFileCrc(const uint8_t* data, std::size_t dataLen)
+{
+  _configFileCrc = esp_rom_crc32_le(0, data, dataLen);
+}
 static bool tryLoadConfig()
 {
   TinyVec<uint8_t> buffer;
@@ -101,11 +166,25 @@ static bool tryLoadConfig()
     return false;
   }
 
-  return tryDeserializeConfig(buffer.data(), buffer.size(), _configData);
+  if (!tryDeserializeConfig(buffer.data(), buffer.size(), _configData)) {
+    return false;
+  }
+
+  setConfigFileCrc(buffer.data(), buffer.size());
+
+  return true;
+}
+static bool tryRemoveConfigLog()
+{
+  _configLogSize = 0;
+  _configLogTorn = false;
+
+  return _configFS.remove(CONFIG_LOG_FILE) || !_configFS.exists(CONFIG_LOG_FILE);
 }
 static bool trySaveConfig(const uint8_t* data, std::size_t dataLen)
 {
-  File file = _configFS.open("/config", "wb");
+  // Written next to the old file and renamed over it, so a power loss leaves either the old or the new config
+  File file = _configFS.open(CONFIG_TEMP_FILE, "wb");
   if (!file) {
     OS_LOGE(TAG, "Failed to open config file for writing");
     return false;
@@ -119,6 +198,22 @@ static bool trySaveConfig(const uint8_t* data, std::size_t dataLen)
 
   file.close();
 
+  if (!_configFS.rename(CONFIG_TEMP_FILE, "/config")) {
+    // Not every LittleFS build replaces the target on rename
+    _configFS.remove("/config");
+    if (!_configFS.rename(CONFIG_TEMP_FILE, "/config")) {
+      OS_LOGE(TAG, "Failed to replace config file");
+      return false;
+    }
+  }
+
+  setConfigFileCrc(data, dataLen);
+
+  // The log is tied to the CRC of the previous file, so a leftover log is ignored on boot even if this fails
+  if (!tryRemoveConfigLog()) {
+    OS_LOGW(TAG, "Failed to remove config log");
+  }
+
   return true;
 }
 static bool trySaveConfig()
@@ -129,82 +224,462 @@ static bool trySaveConfig()
 
   Serialization::Configuration::FinishHubConfigBuffer(builder, fbsConfig);
 
-  return trySaveConfig(builder.GetBufferPointer(), builder.GetSize());
+  if (!trySaveConfig(builder.GetBufferPointer(), builder.GetSize())) {
+    return false;
+  }
+
+  _configMetrics.compactions++;
+
+  return true;
+}
+
+template<typename T>
+static void serializeSection(flatbuffers::FlatBufferBuilder& builder, const Config::ConfigBase<T>& section)
+{
+  builder.Finish(section.ToFlatbuffers(builder, true));
+}
+static void serializeConfigSection(flatbuffers::FlatBufferBuilder& builder, uint8_t index)
+{
+  switch (index) {
+    case 0:
+      serializeSection(builder, _configData.rf);
+      break;
+    case 1:
+      serializeSection(builder, _configData.wifi);
+      break;
+    case 2:
+      serializeSection(builder, _configData.captivePortal);
+      break;
+    case 3:
+      serializeSection(builder, _configData.backend);
+      break;
+    case 4:
+      serializeSection(builder, _configData.serialInput);
+      break;
+    case 5:
+      serializeSection(builder, _configData.otaUpdate);
+      break;
+    case 6:
+      serializeSection(builder, _configData.estop);
+      break;
+    default:
+      break;
+  }
+}
+
+template<typename T>
+static bool tryDeserializeSection(const uint8_t* data, std::size_t len, Config::ConfigBase<T>& section)
+{
+  flatbuffers::Verifier verifier(data, len);
+  if (!verifier.VerifyBuffer<T>(nullptr)) {
+    return false;
+  }
+
+  return section.FromFlatbuffers(flatbuffers::GetRoot<T>(data));
+}
+static bool tryDeserializeConfigSection(uint8_t index, const uint8_t* data, std::size_t len)
+{
+  switch (index) {
+    case 0:
+      return tryDeserializeSection(data, len, _configData.rf);
+    case 1:
+      return tryDeserializeSection(data, len, _configData.wifi);
+    case 2:
+      return tryDeserializeSection(data, len, _configData.captivePortal);
+    case 3:
+      return tryDeserializeSection(data, len, _configData.backend);
+    case 4:
+      return tryDeserializeSection(data, len, _configData.serialInput);
+    case 5:
+      return tryDeserializeSection(data, len, _configData.otaUpdate);
+    case 6:
+      return tryDeserializeSection(data, len, _configData.estop);
+    default:
+      return false;
+  }
+}
+
+// Appends the given sections to the log, returns false if the log has to be compacted instead
+static bool tryAppendConfigLog(uint8_t sections)
+{
+  TinyVec<uint8_t> records;
+  if (_configLogSize == 0) {
+    uint8_t header[CONFIG_LOG_HEADER_SIZE] = {
+      CONFIG_LOG_VERSION,
+      static_cast<uint8_t>(_configFileCrc & 0xFF),
+      static_cast<uint8_t>((_configFileCrc >> 8) & 0xFF),
+      static_cast<uint8_t>((_configFileCrc >> 16) & 0xFF),
+      static_cast<uint8_t>((_configFileCrc >> 24) & 0xFF),
+    };
+    records.append(header, sizeof(header));
+  }
+
+  for (uint8_t index = 0; index < Config::SECTION_COUNT; ++index) {
+    if ((sections & (1 << index)) == 0) {
+      continue;
+    }
+
+    flatbuffers::FlatBufferBuilder builder;
+    serializeConfigSection(builder, index);
+
+    std::size_t length = builder.GetSize();
+    if (_configLogSize + records.size() + CONFIG_LOG_RECORD_HEADER_SIZE + length > CONFIG_LOG_MAX) {
+      return false;
+    }
+
+    uint8_t header[CONFIG_LOG_RECORD_HEADER_SIZE] = {
+      index,
+      static_cast<uint8_t>(length & 0xFF),
+      static_cast<uint8_t>(length >> 8),
+    };
+
+    uint32_t crc = esp_rom_crc32_le(0, header, 3);
+    crc          = esp_rom_crc32_le(crc, builder.GetBufferPointer(), length);
+
+    header[3] = static_cast<uint8_t>(crc & 0xFF);
+    header[4] = static_cast<uint8_t>((crc >> 8) & 0xFF);
+    header[5] = static_cast<uint8_t>((crc >> 16) & 0xFF);
+    header[6] = static_cast<uint8_t>((crc >> 24) & 0xFF);
+
+    records.append(header, sizeof(header));
+    records.append(builder.GetBufferPointer(), length);
+  }
+
+  File file = _configFS.open(CONFIG_LOG_FILE, _configLogSize == 0 ? "wb" : "ab");
+  if (!file) {
+    OS_LOGE(TAG, "Failed to open config log for writing");
+    return false;
+  }
+
+  // A torn record fails its CRC on boot and is dropped along with everything after it, so later changes have to go to the config file
+  if (file.write(records.data(), records.size()) != records.size()) {
+    OS_LOGE(TAG, "Failed to append to config log");
+    _configLogTorn = true;
+    return false;
+  }
+
+  file.close();
+
+  _configLogSize += records.size();
+  _configMetrics.logBytes += records.size();
+
+  return true;
+}
+
+// Applies the log on top of the loaded config file, returns false if part of it had to be dropped and it should be compacted
+static bool tryReplayConfigLog()
+{
+  if (!_configFS.exists(CONFIG_LOG_FILE)) {
+    return true;
+  }
+
+  File file = _configFS.open(CONFIG_LOG_FILE, "rb");
+  if (!file) {
+    OS_LOGE(TAG, "Failed to open config log for reading");
+    return false;
+  }
+
+  TinyVec<uint8_t> log(file.size());
+  if (file.read(log.data(), log.size()) != log.size()) {
+    OS_LOGE(TAG, "Failed to read config log, size mismatch");
+    return false;
+  }
+
+  file.close();
+
+  if (log.size() < CONFIG_LOG_HEADER_SIZE || log[0] != CONFIG_LOG_VERSION || readU32(log.data() + 1) != _configFileCrc) {
+    OS_LOGW(TAG, "Ignoring config log that does not belong to the config file");
+    return false;
+  }
+
+  std::size_t pos     = CONFIG_LOG_HEADER_SIZE;
+  std::size_t records = 0;
+  while (pos + CONFIG_LOG_RECORD_HEADER_SIZE <= log.size()) {
+    const uint8_t* header = log.data() + pos;
+    const uint8_t* data   = header + CONFIG_LOG_RECORD_HEADER_SIZE;
+    std::size_t length    = header[1] | (header[2] << 8);
+
+    if (pos + CONFIG_LOG_RECORD_HEADER_SIZE + length > log.size()) {
+      break;
+    }
+
+    uint32_t crc = esp_rom_crc32_le(0, header, 3);
+    crc          = esp_rom_crc32_le(crc, data, length);
+    if (crc != readU32(header + 3)) {
+      break;
+    }
+
+    if (!tryDeserializeConfigSection(header[0], data, length)) {
+      OS_LOGE(TAG, "Failed to apply config log record for section %u", header[0]);
+      break;
+    }
+
+    pos += CONFIG_LOG_RECORD_HEADER_SIZE + length;
+    records++;
+  }
+
+  OS_LOGI(TAG, "Replayed %zu config log records", records);
+
+  if (pos != log.size()) {
+    OS_LOGW(TAG, "Dropped %zu bytes of incomplete config log", log.size() - pos);
+    return false;
+  }
+
+  _configLogSize = log.size();
+
+  return true;
+}
+
+// Caller must hold the write lock
+static void publishConfigSnapshot()
+{
+  std::atomic_store(&_configSnapshot, std::make_shared<const Config::RootConfig>(_configData));
+}
+
+// Caller must hold the write lock
+static void publishConfigChange(uint8_t sections)
+{
+  publishConfigSnapshot();
+
+  Config::ChangedEventData data {
+    .sections   = sections,
+    .generation = ++_configGeneration,
+  };
+
+  // Never wait here, a handler may be blocked on the config lock this caller holds. Before Events::Init there is nobody to tell.
+  esp_err_t err = esp_event_post(OPENSHOCK_EVENTS, OPENSHOCK_EVENT_CONFIG_CHANGED, &data, sizeof(data), 0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    OS_LOGW(TAG, "Failed to post config change event: %s", esp_err_to_name(err));
+  }
+}
+
+// Caller must hold the write lock
+static bool tryFlushConfig()
+{
+  if (_configDirtySections == 0) {
+    return true;
+  }
+
+  // Small changes go to the log, the whole file is only rewritten once the log is full
+  bool appended = _configDirtySections != Config::SECTION_ALL && !_configLogTorn && tryAppendConfigLog(_configDirtySections);
+  if (!appended && !trySaveConfig()) {
+    return false;
+  }
+
+  _configMetrics.writes++;
+  _configMetrics.writesAvoided += _configPendingSaves - 1;
+
+  _configDirtySections = 0;
+  _configPendingSaves  = 0;
+
+  return true;
+}
+
+// Caller must hold the write lock, the change is written by the flush task once changes stop coming in
+static bool markConfigDirty(uint8_t sections)
+{
+  publishConfigChange(sections);
+
+  _configDirtySections |= sections;
+  _configPendingSaves++;
+
+  if (_configFlushTaskHandle == nullptr) {
+    return tryFlushConfig();
+  }
+
+  xTaskNotifyGive(_configFlushTaskHandle);
+
+  return true;
+}
+
+// Caller must hold the write lock, used for state that has to be on flash before the caller continues
+static bool saveConfigNow(uint8_t sections)
+{
+  publishConfigChange(sections);
+
+  _configDirtySections |= sections;
+  _configPendingSaves++;
+
+  return tryFlushConfig();
+}
+
+static void configFlushTask(void*)
+{
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Coalesce every change made until things go quiet, e.g. a captive portal session editing several settings
+    TickType_t firstChange = xTaskGetTickCount();
+    while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_FLUSH_DELAY_MS)) > 0) {
+      if (xTaskGetTickCount() - firstChange >= pdMS_TO_TICKS(CONFIG_FLUSH_MAX_DELAY_MS)) {
+        break;
+      }
+    }
+
+    if (!Config::Flush()) {
+      OS_LOGE(TAG, "Failed to flush config, will retry on the next change");
+    }
+  }
+}
+
+static void configShutdownHandler()
+{
+  // Also runs from OS_PANIC, possibly in a task that still holds the lock, so waiting forever here would hang instead of restarting
+  ScopedWriteLock lock(&_configMutex, pdMS_TO_TICKS(CONFIG_SHUTDOWN_LOCK_MS));
+  if (!lock.isLocked()) {
+    OS_LOGW(TAG, "Config is locked, restarting without flushing pending changes");
+    return;
+  }
+
+  if (!tryFlushConfig()) {
+    OS_LOGE(TAG, "Failed to flush config before restart");
+  }
+}
+
+static bool tryRemoveLcgCache()
+{
+  return _configFS.remove(LCG_CACHE_FILE) || !_configFS.exists(LCG_CACHE_FILE);
+}
+
+static bool tryRemoveOtaResumeState()
+{
+  return _configFS.remove(OTA_RESUME_FILE) || !_configFS.exists(OTA_RESUME_FILE);
+}
+
+// Each URL maps to one of a few fixed files, a colliding URL simply replaces the older entry
+static std::string getHttpCachePath(std::string_view url)
+{
+  uint32_t hash = 2'166'136'261U;
+  for (char c : url) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16'777'619U;
+  }
+
+  return std::string(HTTP_CACHE_FILE_PREFIX) + static_cast<char>('0' + (hash % HTTP_CACHE_SLOTS));
+}
+
+static bool tryRemoveHttpCache()
+{
+  bool success = true;
+  for (std::size_t i = 0; i < HTTP_CACHE_SLOTS; ++i) {
+    std::string path = std::string(HTTP_CACHE_FILE_PREFIX) + static_cast<char>('0' + i);
+    success &= _configFS.remove(path.c_str()) || !_configFS.exists(path.c_str());
+  }
+  return success;
 }
 
 void Config::Init()
 {
   CONFIG_LOCK_WRITE();
 
+  int64_t begin = OpenShock::millis();
+
   if (!_configFS.begin(true, "/config", 3, "config")) {
     OS_PANIC(TAG, "Unable to mount config LittleFS partition!");
   }
 
-  if (tryLoadConfig()) {
-    return;
+  if (!tryLoadConfig()) {
+    OS_LOGW(TAG, "Failed to load config, writing default config");
+
+    _configData.ToDefault();
+
+    if (!saveConfigNow(Config::SECTION_ALL)) {
+      OS_PANIC(TAG, "Failed to save default config. Recommend formatting microcontroller and re-flashing firmware");
+    }
+  } else if (!tryReplayConfigLog() && !saveConfigNow(Config::SECTION_ALL)) {
+    OS_LOGE(TAG, "Failed to compact config log");
   }
 
-  OS_LOGW(TAG, "Failed to load config, writing default config");
+  publishConfigSnapshot();
 
-  _configData.ToDefault();
+  OS_LOGI(TAG, "Config loaded in %lli ms", OpenShock::millis() - begin);
 
-  if (!trySaveConfig()) {
-    OS_PANIC(TAG, "Failed to save default config. Recommend formatting microcontroller and re-flashing firmware");
+  // Without the task every change is written immediately
+  if (TaskUtils::TaskCreateExpensive(configFlushTask, "ConfigFlush", 4096, nullptr, 1, &_configFlushTaskHandle) != pdPASS) {  // TODO: Profile stack size
+    OS_LOGE(TAG, "Failed to create config flush task, changes will be written immediately");
+    _configFlushTaskHandle = nullptr;
+  }
+
+  esp_err_t err = esp_register_shutdown_handler(configShutdownHandler);
+  if (err != ESP_OK) {
+    OS_LOGE(TAG, "Failed to register config shutdown handler: %s", esp_err_to_name(err));
   }
 }
 
-static cJSON* getAsCJSON(bool withSensitiveData)
+bool Config::Flush()
 {
-  CONFIG_LOCK_READ(nullptr);
+  CONFIG_LOCK_WRITE(false);
 
-  return _configData.ToJSON(withSensitiveData);
+  return tryFlushConfig();
 }
 
-std::string Config::GetAsJSON(bool withSensitiveData)
+std::shared_ptr<const Config::RootConfig> Config::GetSnapshot()
 {
-  cJSON* root = getAsCJSON(withSensitiveData);
-  if (root == nullptr) {
-    OS_LOGE(TAG, "Failed to get config as JSON");
-    return {};
-  }
-
-  char* json = cJSON_PrintUnformatted(root);
+  return std::atomic_load(&_configSnapshot);
+}
 
-  std::string result(json);
+uint32_t Config::GetGeneration()
+{
+  return _configGeneration.load(std::memory_order_relaxed);
+}
 
-  free(json);
+Config::PersistMetrics Config::GetPersistMetrics()
+{
+  CONFIG_LOCK_READ({});
 
-  cJSON_Delete(root);
+  return _configMetrics;
+}
 
-  return result;
+ReadWriteMutex::Metrics Config::GetLockMetrics()
+{
+  return _configMutex.getMetrics();
 }
-bool Config::SaveFromJSON(std::string_view json)
+
+std::string Config::GetAsJSON(bool withSensitiveData)
 {
-  cJSON* root = cJSON_ParseWithLength(json.data(), json.size());
-  if (root == nullptr) {
-    OS_LOGE(TAG, "Failed to parse JSON: %s", cJSON_GetErrorPtr());
-    return false;
-  }
+  std::string result;
 
-  CONFIG_LOCK_WRITE_ACTION(false, cJSON_Delete(root));
+  bool success = WriteJSON(
+    [&result](const char* data, std::size_t len) {
+      result.append(data, len);
+      return true;
+    },
+    withSensitiveData
+  );
 
-  bool result = _configData.FromJSON(root);
+  if (!success) {
+    OS_LOGE(TAG, "Failed to get config as JSON");
+    return {};
+  }
 
-  cJSON_Delete(root);
+  return result;
+}
+bool Config::WriteJSON(const JsonSink& sink, bool withSensitiveData)
+{
+  CONFIG_SNAPSHOT(false);
 
-  if (!result) {
+  return config->WriteJSON(sink, withSensitiveData);
+}
+bool Config::SaveFromJSON(std::string_view json)
+{
+  // Every section is either read from the JSON or reset to defaults, so it can be parsed without the lock
+  Config::RootConfig config;
+  if (!config.ReadJSON(json)) {
     OS_LOGE(TAG, "Failed to read JSON");
     return false;
   }
 
-  return trySaveConfig();
+  CONFIG_LOCK_WRITE(false);
+
+  _configData = std::move(config);
+
+  return saveConfigNow(Config::SECTION_ALL);
 }
 
 flatbuffers::Offset<Serialization::Configuration::HubConfig> Config::GetAsFlatBuffer(flatbuffers::FlatBufferBuilder& builder, bool withSensitiveData)
 {
-  CONFIG_LOCK_READ(0);
+  CONFIG_SNAPSHOT(0);
 
-  return _configData.ToFlatbuffers(builder, withSensitiveData);
+  return config->ToFlatbuffers(builder, withSensitiveData);
 }
 
 bool Config::SaveFromFlatBuffer(const Serialization::Configuration::HubConfig* config)
@@ -216,14 +691,23 @@ bool Config::SaveFromFlatBuffer(const Serialization::Configuration::HubConfig* c
     return false;
   }
 
-  return trySaveConfig();
+  return saveConfigNow(Config::SECTION_ALL);
 }
 
 bool Config::GetRaw(TinyVec<uint8_t>& buffer)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
+
+  // Built from memory rather than read from flash, so it also holds changes that are only in the log or not yet flushed
+  flatbuffers::FlatBufferBuilder builder;
 
-  return tryLoadConfig(buffer);
+  auto fbsConfig = config->ToFlatbuffers(builder, true);
+
+  Serialization::Configuration::FinishHubConfigBuffer(builder, fbsConfig);
+
+  buffer.assign(builder.GetBufferPointer(), builder.GetSize());
+
+  return true;
 }
 
 bool Config::SetRaw(const uint8_t* buffer, std::size_t size)
@@ -236,7 +720,18 @@ bool Config::SetRaw(const uint8_t* buffer, std::size_t size)
     return false;
   }
 
-  return trySaveConfig(buffer, size);
+  if (!trySaveConfig(buffer, size)) {
+    return false;
+  }
+
+  // The raw file replaces any pending change, it takes effect after a restart
+  _configMetrics.writes++;
+  _configMetrics.writesAvoided += _configPendingSaves;
+
+  _configDirtySections = 0;
+  _configPendingSaves  = 0;
+
+  return true;
 }
 
 void Config::FactoryReset()
@@ -249,7 +744,19 @@ void Config::FactoryReset()
     OS_PANIC(TAG, "Failed to remove existing config file for factory reset. Reccomend formatting microcontroller and re-flashing firmware");
   }
 
-  if (!trySaveConfig()) {
+  if (!tryRemoveLcgCache()) {
+    OS_LOGE(TAG, "Failed to remove LCG cache file for factory reset");
+  }
+
+  if (!tryRemoveOtaResumeState()) {
+    OS_LOGE(TAG, "Failed to remove OTA resume file for factory reset");
+  }
+
+  if (!tryRemoveHttpCache()) {
+    OS_LOGE(TAG, "Failed to remove HTTP cache files for factory reset");
+  }
+
+  if (!saveConfigNow(Config::SECTION_ALL)) {
     OS_PANIC(TAG, "Failed to save default config. Recommend formatting microcontroller and re-flashing firmware");
   }
 
@@ -258,63 +765,63 @@ void Config::FactoryReset()
 
 bool Config::GetRFConfig(Config::RFConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.rf;
+  out = config->rf;
 
   return true;
 }
 
 bool Config::GetWiFiConfig(Config::WiFiConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.wifi;
+  out = config->wifi;
 
   return true;
 }
 
 bool Config::GetCaptivePortalConfig(Config::CaptivePortalConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.captivePortal;
+  out = config->captivePortal;
 
   return true;
 }
 
 bool Config::GetBackendConfig(Config::BackendConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.backend;
+  out = config->backend;
 
   return true;
 }
 
 bool Config::GetSerialInputConfig(Config::SerialInputConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.serialInput;
+  out = config->serialInput;
 
   return true;
 }
 
 bool Config::GetOtaUpdateConfig(Config::OtaUpdateConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.otaUpdate;
+  out = config->otaUpdate;
 
   return true;
 }
 
 bool Config::GetEStop(Config::EStopConfig& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.estop;
+  out = config->estop;
 
   return true;
 }
@@ -324,7 +831,7 @@ bool Config::SetRFConfig(const Config::RFConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.rf = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_RF);
 }
 
 bool Config::SetWiFiConfig(const Config::WiFiConfig& config)
@@ -332,7 +839,7 @@ bool Config::SetWiFiConfig(const Config::WiFiConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.wifi = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_WIFI);
 }
 
 bool Config::SetCaptivePortalConfig(const Config::CaptivePortalConfig& config)
@@ -340,15 +847,17 @@ bool Config::SetCaptivePortalConfig(const Config::CaptivePortalConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.captivePortal = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_CAPTIVEPORTAL);
 }
 
 bool Config::SetBackendConfig(const Config::BackendConfig& config)
 {
   CONFIG_LOCK_WRITE(false);
 
+  tryRemoveLcgCache();
+
   _configData.backend = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_BACKEND);
 }
 
 bool Config::SetSerialInputConfig(const Config::SerialInputConfig& config)
@@ -356,7 +865,7 @@ bool Config::SetSerialInputConfig(const Config::SerialInputConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.serialInput = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_SERIALINPUT);
 }
 
 bool Config::SetOtaUpdateConfig(const Config::OtaUpdateConfig& config)
@@ -364,7 +873,7 @@ bool Config::SetOtaUpdateConfig(const Config::OtaUpdateConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.otaUpdate = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_OTAUPDATE);
 }
 
 bool Config::SetEStop(const Config::EStopConfig& config)
@@ -372,23 +881,23 @@ bool Config::SetEStop(const Config::EStopConfig& config)
   CONFIG_LOCK_WRITE(false);
 
   _configData.estop = config;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_ESTOP);
 }
 
 bool Config::GetWiFiCredentials(std::vector<Config::WiFiCredentials>& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.wifi.credentialsList;
+  out = config->wifi.credentialsList;
 
   return true;
 }
 
 bool Config::GetWiFiCredentials(cJSON* array, bool withSensitiveData)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  for (auto& creds : _configData.wifi.credentialsList) {
+  for (auto& creds : config->wifi.credentialsList) {
     cJSON* jsonCreds = creds.ToJSON(withSensitiveData);
 
     cJSON_AddItemToArray(array, jsonCreds);
@@ -408,14 +917,14 @@ bool Config::SetWiFiCredentials(const std::vector<Config::WiFiCredentials>& cred
   CONFIG_LOCK_WRITE(false);
 
   _configData.wifi.credentialsList = credentials;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_WIFI);
 }
 
 bool Config::GetRFConfigTxPin(gpio_num_t& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.rf.txPin;
+  out = config->rf.txPin;
 
   return true;
 }
@@ -425,14 +934,14 @@ bool Config::SetRFConfigTxPin(gpio_num_t txPin)
   CONFIG_LOCK_WRITE(false);
 
   _configData.rf.txPin = txPin;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_RF);
 }
 
 bool Config::GetRFConfigKeepAliveEnabled(bool& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.rf.keepAliveEnabled;
+  out = config->rf.keepAliveEnabled;
 
   return true;
 }
@@ -442,14 +951,14 @@ bool Config::SetRFConfigKeepAliveEnabled(bool enabled)
   CONFIG_LOCK_WRITE(false);
 
   _configData.rf.keepAliveEnabled = enabled;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_RF);
 }
 
 bool Config::AnyWiFiCredentials(std::function<bool(const Config::WiFiCredentials&)> predicate)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  auto& creds = _configData.wifi.credentialsList;
+  auto& creds = config->wifi.credentialsList;
 
   return std::any_of(creds.begin(), creds.end(), predicate);
 }
@@ -470,7 +979,7 @@ uint8_t Config::AddWiFiCredentials(std::string_view ssid, std::string_view passw
         creds.authMode = authMode;
       }
 
-      if (!trySaveConfig()) {
+      if (!markConfigDirty(Config::SECTION_WIFI)) {
         OS_LOGE(TAG, "Failed to persist updated WiFi credentials for SSID %.*s", static_cast<int>(ssid.size()), ssid.data());
         return 0;
       }
@@ -502,16 +1011,16 @@ uint8_t Config::AddWiFiCredentials(std::string_view ssid, std::string_view passw
   }
 
   _configData.wifi.credentialsList.emplace_back(id, ssid, password, authMode);
-  trySaveConfig();
+  markConfigDirty(Config::SECTION_WIFI);
 
   return id;
 }
 
 bool Config::TryGetWiFiCredentialsByID(uint8_t id, Config::WiFiCredentials& credentials)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  for (const auto& creds : _configData.wifi.credentialsList) {
+  for (const auto& creds : config->wifi.credentialsList) {
     if (creds.id == id) {
       credentials = creds;
       return true;
@@ -523,9 +1032,9 @@ bool Config::TryGetWiFiCredentialsByID(uint8_t id, Config::WiFiCredentials& cred
 
 bool Config::TryGetWiFiCredentialsBySSID(const char* ssid, Config::WiFiCredentials& credentials)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  for (const auto& creds : _configData.wifi.credentialsList) {
+  for (const auto& creds : config->wifi.credentialsList) {
     if (creds.ssid == ssid) {
       credentials = creds;
       return true;
@@ -537,9 +1046,9 @@ bool Config::TryGetWiFiCredentialsBySSID(const char* ssid, Config::WiFiCredentia
 
 uint8_t Config::GetWiFiCredentialsIDbySSID(const char* ssid)
 {
-  CONFIG_LOCK_READ(0);
+  CONFIG_SNAPSHOT(0);
 
-  for (const auto& creds : _configData.wifi.credentialsList) {
+  for (const auto& creds : config->wifi.credentialsList) {
     if (creds.ssid == ssid) {
       return creds.id;
     }
@@ -555,7 +1064,7 @@ bool Config::PinWiFiCredentialsBSSID(uint8_t id, const uint8_t (&bssid)[6])
   for (auto& creds : _configData.wifi.credentialsList) {
     if (creds.id == id) {
       memcpy(creds.bssid.data(), bssid, 6);
-      return trySaveConfig();
+      return markConfigDirty(Config::SECTION_WIFI);
     }
   }
 
@@ -569,7 +1078,7 @@ bool Config::RemoveWiFiCredentials(uint8_t id)
   for (auto it = _configData.wifi.credentialsList.begin(); it != _configData.wifi.credentialsList.end(); ++it) {
     if (it->id == id) {
       _configData.wifi.credentialsList.erase(it);
-      trySaveConfig();
+      markConfigDirty(Config::SECTION_WIFI);
       return true;
     }
   }
@@ -583,14 +1092,14 @@ bool Config::ClearWiFiCredentials()
 
   _configData.wifi.credentialsList.clear();
 
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_WIFI);
 }
 
 bool Config::GetWiFiHostname(std::string& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.wifi.hostname;
+  out = config->wifi.hostname;
 
   return true;
 }
@@ -601,14 +1110,14 @@ bool Config::SetWiFiHostname(std::string hostname)
 
   _configData.wifi.hostname = std::move(hostname);
 
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_WIFI);
 }
 
 bool Config::GetBackendDomain(std::string& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.backend.domain;
+  out = config->backend.domain;
 
   return true;
 }
@@ -618,21 +1127,22 @@ bool Config::SetBackendDomain(std::string domain)
   CONFIG_LOCK_WRITE(false);
 
   _configData.backend.domain = std::move(domain);
-  return trySaveConfig();
+  tryRemoveLcgCache();
+  return markConfigDirty(Config::SECTION_BACKEND);
 }
 
 bool Config::HasBackendAuthToken()
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  return !_configData.backend.authToken.empty();
+  return !config->backend.authToken.empty();
 }
 
 bool Config::GetBackendAuthToken(std::string& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.backend.authToken;
+  out = config->backend.authToken;
 
   return true;
 }
@@ -642,7 +1152,8 @@ bool Config::SetBackendAuthToken(std::string token)
   CONFIG_LOCK_WRITE(false);
 
   _configData.backend.authToken = std::move(token);
-  return trySaveConfig();
+  tryRemoveLcgCache();
+  return markConfigDirty(Config::SECTION_BACKEND);
 }
 
 bool Config::ClearBackendAuthToken()
@@ -650,14 +1161,105 @@ bool Config::ClearBackendAuthToken()
   CONFIG_LOCK_WRITE(false);
 
   _configData.backend.authToken.clear();
-  return trySaveConfig();
+  tryRemoveLcgCache();
+  return markConfigDirty(Config::SECTION_BACKEND);
 }
 
-bool Config::GetSerialInputConfigEchoEnabled(bool& out)
+bool Config::GetBackendLcgCache(std::string& host, uint16_t& port, std::string& path)
 {
   CONFIG_LOCK_READ(false);
 
-  out = _configData.serialInput.echoEnabled;
+  File file = _configFS.open(LCG_CACHE_FILE, "rb");
+  if (!file) {
+    return false;
+  }
+
+  // Layout: version (u8), port (u16 LE), host length (u8), host, path length (u8), path
+  std::size_t size = file.size();
+  if (size < 5 || size > LCG_CACHE_MAX) {
+    OS_LOGW(TAG, "LCG cache file has an invalid size");
+    return false;
+  }
+
+  uint8_t buffer[LCG_CACHE_MAX];
+  if (file.read(buffer, size) != size) {
+    OS_LOGE(TAG, "Failed to read LCG cache file");
+    return false;
+  }
+
+  file.close();
+
+  if (buffer[0] != LCG_CACHE_VERSION) {
+    return false;
+  }
+
+  std::size_t hostLen = buffer[3];
+  if (hostLen == 0 || 4 + hostLen + 1 > size) {
+    return false;
+  }
+
+  std::size_t pathLen = buffer[4 + hostLen];
+  if (5 + hostLen + pathLen != size) {
+    return false;
+  }
+
+  port = static_cast<uint16_t>(buffer[1] | (buffer[2] << 8));
+  host.assign(reinterpret_cast<const char*>(buffer + 4), hostLen);
+  path.assign(reinterpret_cast<const char*>(buffer + 5 + hostLen), pathLen);
+
+  return true;
+}
+
+bool Config::SetBackendLcgCache(std::string_view host, uint16_t port, std::string_view path)
+{
+  if (host.empty() || host.size() > UINT8_MAX || path.size() > UINT8_MAX || 5 + host.size() + path.size() > LCG_CACHE_MAX) {
+    OS_LOGE(TAG, "LCG endpoint is too large to cache");
+    return false;
+  }
+
+  CONFIG_LOCK_WRITE(false);
+
+  uint8_t buffer[LCG_CACHE_MAX];
+  std::size_t size = 0;
+
+  buffer[size++] = LCG_CACHE_VERSION;
+  buffer[size++] = static_cast<uint8_t>(port & 0xFF);
+  buffer[size++] = static_cast<uint8_t>(port >> 8);
+  buffer[size++] = static_cast<uint8_t>(host.size());
+  memcpy(buffer + size, host.data(), host.size());
+  size += host.size();
+  buffer[size++] = static_cast<uint8_t>(path.size());
+  memcpy(buffer + size, path.data(), path.size());
+  size += path.size();
+
+  File file = _configFS.open(LCG_CACHE_FILE, "wb");
+  if (!file) {
+    OS_LOGE(TAG, "Failed to open LCG cache file for writing");
+    return false;
+  }
+
+  if (file.write(buffer, size) != size) {
+    OS_LOGE(TAG, "Failed to write LCG cache file");
+    return false;
+  }
+
+  file.close();
+
+  return true;
+}
+
+bool Config::ClearBackendLcgCache()
+{
+  CONFIG_LOCK_WRITE(false);
+
+  return tryRemoveLcgCache();
+}
+
+bool Config::GetSerialInputConfigEchoEnabled(bool& out)
+{
+  CONFIG_SNAPSHOT(false);
+
+  out = config->serialInput.echoEnabled;
   return true;
 }
 
@@ -666,14 +1268,14 @@ bool Config::SetSerialInputConfigEchoEnabled(bool enabled)
   CONFIG_LOCK_WRITE(false);
 
   _configData.serialInput.echoEnabled = enabled;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_SERIALINPUT);
 }
 
 bool Config::GetOtaUpdateId(int32_t& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.otaUpdate.updateId;
+  out = config->otaUpdate.updateId;
 
   return true;
 }
@@ -687,14 +1289,14 @@ bool Config::SetOtaUpdateId(int32_t updateId)
   }
 
   _configData.otaUpdate.updateId = updateId;
-  return trySaveConfig();
+  return saveConfigNow(Config::SECTION_OTAUPDATE);
 }
 
 bool Config::GetOtaUpdateStep(OtaUpdateStep& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.otaUpdate.updateStep;
+  out = config->otaUpdate.updateStep;
 
   return true;
 }
@@ -708,14 +1310,203 @@ bool Config::SetOtaUpdateStep(OtaUpdateStep updateStep)
   }
 
   _configData.otaUpdate.updateStep = updateStep;
-  return trySaveConfig();
+  return saveConfigNow(Config::SECTION_OTAUPDATE);
 }
 
-bool Config::GetEStopEnabled(bool& out)
+bool Config::GetOtaResumeState(std::string& partitionLabel, std::string& url, uint8_t (&hash)[32], uint32_t& offset)
 {
   CONFIG_LOCK_READ(false);
 
-  out = _configData.estop.enabled;
+  File file = _configFS.open(OTA_RESUME_FILE, "rb");
+  if (!file) {
+    return false;
+  }
+
+  // Layout: version (u8), offset (u32 LE), hash (32 bytes), label length (u8), label, url length (u16 LE), url
+  std::size_t size = file.size();
+  if (size < 40 || size > OTA_RESUME_MAX) {
+    OS_LOGW(TAG, "OTA resume file has an invalid size");
+    return false;
+  }
+
+  uint8_t buffer[OTA_RESUME_MAX];
+  if (file.read(buffer, size) != size) {
+    OS_LOGE(TAG, "Failed to read OTA resume file");
+    return false;
+  }
+
+  file.close();
+
+  if (buffer[0] != OTA_RESUME_VERSION) {
+    return false;
+  }
+
+  std::size_t labelLen = buffer[37];
+  if (labelLen == 0 || 38 + labelLen + 2 > size) {
+    return false;
+  }
+
+  std::size_t urlLen = buffer[38 + labelLen] | (buffer[39 + labelLen] << 8);
+  if (40 + labelLen + urlLen != size) {
+    return false;
+  }
+
+  offset = static_cast<uint32_t>(buffer[1]) | (static_cast<uint32_t>(buffer[2]) << 8) | (static_cast<uint32_t>(buffer[3]) << 16) | (static_cast<uint32_t>(buffer[4]) << 24);
+  memcpy(hash, buffer + 5, 32);
+  partitionLabel.assign(reinterpret_cast<const char*>(buffer + 38), labelLen);
+  url.assign(reinterpret_cast<const char*>(buffer + 40 + labelLen), urlLen);
+
+  return true;
+}
+
+bool Config::SetOtaResumeState(std::string_view partitionLabel, std::string_view url, const uint8_t (&hash)[32], uint32_t offset)
+{
+  if (partitionLabel.empty() || partitionLabel.size() > UINT8_MAX || 40 + partitionLabel.size() + url.size() > OTA_RESUME_MAX) {
+    OS_LOGE(TAG, "OTA resume state is too large to store");
+    return false;
+  }
+
+  CONFIG_LOCK_WRITE(false);
+
+  uint8_t buffer[OTA_RESUME_MAX];
+  std::size_t size = 0;
+
+  buffer[size++] = OTA_RESUME_VERSION;
+  buffer[size++] = static_cast<uint8_t>(offset & 0xFF);
+  buffer[size++] = static_cast<uint8_t>((offset >> 8) & 0xFF);
+  buffer[size++] = static_cast<uint8_t>((offset >> 16) & 0xFF);
+  buffer[size++] = static_cast<uint8_t>(offset >> 24);
+  memcpy(buffer + size, hash, 32);
+  size += 32;
+  buffer[size++] = static_cast<uint8_t>(partitionLabel.size());
+  memcpy(buffer + size, partitionLabel.data(), partitionLabel.size());
+  size += partitionLabel.size();
+  buffer[size++] = static_cast<uint8_t>(url.size() & 0xFF);
+  buffer[size++] = static_cast<uint8_t>(url.size() >> 8);
+  memcpy(buffer + size, url.data(), url.size());
+  size += url.size();
+
+  File file = _configFS.open(OTA_RESUME_FILE, "wb");
+  if (!file) {
+    OS_LOGE(TAG, "Failed to open OTA resume file for writing");
+    return false;
+  }
+
+  if (file.write(buffer, size) != size) {
+    OS_LOGE(TAG, "Failed to write OTA resume file");
+    return false;
+  }
+
+  file.close();
+
+  return true;
+}
+
+bool Config::ClearOtaResumeState()
+{
+  CONFIG_LOCK_WRITE(false);
+
+  return tryRemoveOtaResumeState();
+}
+
+bool Config::GetHttpCacheEntry(std::string_view url, std::string& etag, std::string& lastModified, std::string& body)
+{
+  CONFIG_LOCK_READ(false);
+
+  std::string path = getHttpCachePath(url);
+
+  File file = _configFS.open(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+
+  // Layout: version (u8), url length (u16 LE), etag length (u8), last-modified length (u8), url, etag, last-modified, body
+  std::size_t size = file.size();
+  if (size < HTTP_CACHE_HEADER_SIZE || size > HTTP_CACHE_MAX) {
+    OS_LOGW(TAG, "HTTP cache file has an invalid size");
+    return false;
+  }
+
+  uint8_t header[HTTP_CACHE_HEADER_SIZE];
+  if (file.read(header, sizeof(header)) != sizeof(header) || header[0] != HTTP_CACHE_VERSION) {
+    return false;
+  }
+
+  std::size_t urlLen          = header[1] | (header[2] << 8);
+  std::size_t etagLen         = header[3];
+  std::size_t lastModifiedLen = header[4];
+  if (HTTP_CACHE_HEADER_SIZE + urlLen + etagLen + lastModifiedLen > size || urlLen != url.size()) {
+    return false;
+  }
+
+  std::string storedUrl(urlLen, '\0');
+  if (file.read(reinterpret_cast<uint8_t*>(storedUrl.data()), urlLen) != urlLen || storedUrl != url) {
+    return false;  // Slot holds another URL
+  }
+
+  etag.resize(etagLen);
+  lastModified.resize(lastModifiedLen);
+  body.resize(size - HTTP_CACHE_HEADER_SIZE - urlLen - etagLen - lastModifiedLen);
+  if (file.read(reinterpret_cast<uint8_t*>(etag.data()), etagLen) != etagLen || file.read(reinterpret_cast<uint8_t*>(lastModified.data()), lastModifiedLen) != lastModifiedLen || file.read(reinterpret_cast<uint8_t*>(body.data()), body.size()) != body.size()) {
+    OS_LOGE(TAG, "Failed to read HTTP cache file");
+    return false;
+  }
+
+  file.close();
+
+  return true;
+}
+
+bool Config::SetHttpCacheEntry(std::string_view url, std::string_view etag, std::string_view lastModified, std::string_view body)
+{
+  if (url.size() > UINT16_MAX || etag.size() > UINT8_MAX || lastModified.size() > UINT8_MAX || HTTP_CACHE_HEADER_SIZE + url.size() + etag.size() + lastModified.size() + body.size() > HTTP_CACHE_MAX) {
+    return false;  // Not worth caching
+  }
+
+  CONFIG_LOCK_WRITE(false);
+
+  uint8_t header[HTTP_CACHE_HEADER_SIZE] = {
+    HTTP_CACHE_VERSION,
+    static_cast<uint8_t>(url.size() & 0xFF),
+    static_cast<uint8_t>(url.size() >> 8),
+    static_cast<uint8_t>(etag.size()),
+    static_cast<uint8_t>(lastModified.size()),
+  };
+
+  std::string path = getHttpCachePath(url);
+
+  File file = _configFS.open(path.c_str(), "wb");
+  if (!file) {
+    OS_LOGE(TAG, "Failed to open HTTP cache file for writing");
+    return false;
+  }
+
+  for (std::string_view part : {std::string_view(reinterpret_cast<const char*>(header), sizeof(header)), url, etag, lastModified, body}) {
+    if (file.write(reinterpret_cast<const uint8_t*>(part.data()), part.size()) != part.size()) {
+      OS_LOGE(TAG, "Failed to write HTTP cache file");
+      file.close();
+      _configFS.remove(path.c_str());
+      return false;
+    }
+  }
+
+  file.close();
+
+  return true;
+}
+
+bool Config::ClearHttpCache()
+{
+  CONFIG_LOCK_WRITE(false);
+
+  return tryRemoveHttpCache();
+}
+
+bool Config::GetEStopEnabled(bool& out)
+{
+  CONFIG_SNAPSHOT(false);
+
+  out = config->estop.enabled;
 
   return true;
 }
@@ -725,14 +1516,14 @@ bool Config::SetEStopEnabled(bool enabled)
   CONFIG_LOCK_WRITE(false);
 
   _configData.estop.enabled = enabled;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_ESTOP);
 }
 
 bool Config::GetEStopGpioPin(gpio_num_t& out)
 {
-  CONFIG_LOCK_READ(false);
+  CONFIG_SNAPSHOT(false);
 
-  out = _configData.estop.gpioPin;
+  out = config->estop.gpioPin;
 
   return true;
 }
@@ -747,5 +1538,5 @@ bool Config::SetEStopGpioPin(gpio_num_t gpioPin)
   }
 
   _configData.estop.gpioPin = gpioPin;
-  return trySaveConfig();
+  return markConfigDirty(Config::SECTION_ESTOP);
 }
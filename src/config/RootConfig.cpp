@@ -2,10 +2,59 @@
 
 const char* const TAG = "Config::RootConfig";
 
+#include "config/internal/utils.h"
 #include "Logging.h"
 
+#include <cstdlib>
+#include <cstring>
+
 using namespace OpenShock::Config;
 
+template<typename T>
+static bool readJSONSection(ConfigBase<T>& section, std::string_view json, const char* name)
+{
+  if (json.empty()) {
+    return section.FromJSON(nullptr);
+  }
+
+  cJSON* root = cJSON_ParseWithLength(json.data(), json.size());
+  if (root == nullptr) {
+    OS_LOGE(TAG, "Failed to parse %s config: %s", name, cJSON_GetErrorPtr());
+    return false;
+  }
+
+  bool result = section.FromJSON(root);
+
+  cJSON_Delete(root);
+
+  if (!result) {
+    OS_LOGE(TAG, "Unable to load %s config", name);
+  }
+
+  return result;
+}
+
+static bool writeJSONSection(const JsonSink& sink, const char* prefix, cJSON* json)
+{
+  if (json == nullptr) {
+    return false;
+  }
+
+  char* str = cJSON_PrintUnformatted(json);
+
+  cJSON_Delete(json);
+
+  if (str == nullptr) {
+    return false;
+  }
+
+  bool result = sink(prefix, strlen(prefix)) && sink(str, strlen(str));
+
+  free(str);
+
+  return result;
+}
+
 RootConfig::RootConfig()
   : rf()
   , wifi()
@@ -138,6 +187,64 @@ bool RootConfig::FromJSON(const cJSON* json)
   return true;
 }
 
+bool RootConfig::ReadJSON(std::string_view json)
+{
+  // Only the spans of the sections are located here, each one is parsed on its own below
+  std::string_view rfJson, wifiJson, captivePortalJson, backendJson, serialInputJson, otaUpdateJson, estopJson;
+
+  bool isObject = Internal::Utils::ForEachJsonMember(json, [&](std::string_view key, std::string_view value) {
+    std::string_view* target = nullptr;
+    if (key == "rf") {
+      target = &rfJson;
+    } else if (key == "wifi") {
+      target = &wifiJson;
+    } else if (key == "captivePortal") {
+      target = &captivePortalJson;
+    } else if (key == "backend") {
+      target = &backendJson;
+    } else if (key == "serialInput") {
+      target = &serialInputJson;
+    } else if (key == "otaUpdate") {
+      target = &otaUpdateJson;
+    } else if (key == "estop") {
+      target = &estopJson;
+    }
+
+    // First occurrence wins, like cJSON_GetObjectItemCaseSensitive
+    if (target != nullptr && target->empty()) {
+      *target = value;
+    }
+
+    return true;
+  });
+
+  if (!isObject) {
+    OS_LOGE(TAG, "json is not an object");
+    return false;
+  }
+
+  return readJSONSection(rf, rfJson, "rf")
+      && readJSONSection(wifi, wifiJson, "wifi")
+      && readJSONSection(captivePortal, captivePortalJson, "captive portal")
+      && readJSONSection(backend, backendJson, "backend")
+      && readJSONSection(serialInput, serialInputJson, "serial input")
+      && readJSONSection(otaUpdate, otaUpdateJson, "ota update")
+      && readJSONSection(estop, estopJson, "estop");
+}
+
+bool RootConfig::WriteJSON(const JsonSink& sink, bool withSensitiveData) const
+{
+  // Each section's tree is printed and freed before the next one is built
+  return writeJSONSection(sink, "{\"rf\":", rf.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"wifi\":", wifi.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"captivePortal\":", captivePortal.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"backend\":", backend.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"serialInput\":", serialInput.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"otaUpdate\":", otaUpdate.ToJSON(withSensitiveData))
+      && writeJSONSection(sink, ",\"estop\":", estop.ToJSON(withSensitiveData))
+      && sink("}", 1);
+}
+
 cJSON* RootConfig::ToJSON(bool withSensitiveData) const
 {
   cJSON* root = cJSON_CreateObject();
@@ -6,8 +6,73 @@ const char* const TAG = "Config::Internal::Utils";
 #include "Logging.h"
 #include "util/IPAddressUtils.h"
 
+#include <cctype>
+
 using namespace OpenShock;
 
+static std::size_t skipJsonWhitespace(std::string_view json, std::size_t pos)
+{
+  while (pos < json.size() && isspace(static_cast<unsigned char>(json[pos])) != 0) {
+    ++pos;
+  }
+  return pos;
+}
+
+// pos is at the opening quote, returns the position after the closing quote
+static std::size_t skipJsonString(std::string_view json, std::size_t pos)
+{
+  for (++pos; pos < json.size(); ++pos) {
+    if (json[pos] == '\\') {
+      ++pos;
+    } else if (json[pos] == '"') {
+      return pos + 1;
+    }
+  }
+  return std::string_view::npos;
+}
+
+// Only finds where the value ends, whether it is valid is left to the parser that gets it
+static std::size_t skipJsonValue(std::string_view json, std::size_t pos)
+{
+  if (pos >= json.size()) {
+    return std::string_view::npos;
+  }
+
+  char c = json[pos];
+  if (c == '"') {
+    return skipJsonString(json, pos);
+  }
+
+  if (c == '{' || c == '[') {
+    std::size_t depth = 0;
+    while (pos < json.size()) {
+      c = json[pos];
+      if (c == '"') {
+        pos = skipJsonString(json, pos);
+        if (pos == std::string_view::npos) {
+          return pos;
+        }
+        continue;
+      }
+
+      if (c == '{' || c == '[') {
+        ++depth;
+      } else if ((c == '}' || c == ']') && --depth == 0) {
+        return pos + 1;
+      }
+      ++pos;
+    }
+    return std::string_view::npos;
+  }
+
+  // Number, true, false or null
+  std::size_t end = pos;
+  while (end < json.size() && json[end] != ',' && json[end] != '}' && json[end] != ']' && isspace(static_cast<unsigned char>(json[end])) == 0) {
+    ++end;
+  }
+  return end == pos ? std::string_view::npos : end;
+}
+
 template<typename T>
 static bool utilFromJsonInt(T& val, const cJSON* json, const char* name, T defaultVal, int minVal, int maxVal)
 {
@@ -189,3 +254,53 @@ void Config::Internal::Utils::FromJsonGpioNum(gpio_num_t& val, const cJSON* json
     val = defaultVal;
   }
 }
+
+bool Config::Internal::Utils::ForEachJsonMember(std::string_view json, const std::function<bool(std::string_view key, std::string_view value)>& callback)
+{
+  std::size_t pos = skipJsonWhitespace(json, 0);
+  if (pos >= json.size() || json[pos] != '{') {
+    return false;
+  }
+
+  pos = skipJsonWhitespace(json, pos + 1);
+  if (pos < json.size() && json[pos] == '}') {
+    return true;
+  }
+
+  while (pos < json.size() && json[pos] == '"') {
+    std::size_t keyEnd = skipJsonString(json, pos);
+    if (keyEnd == std::string_view::npos) {
+      return false;
+    }
+
+    std::string_view key = json.substr(pos + 1, keyEnd - pos - 2);
+
+    pos = skipJsonWhitespace(json, keyEnd);
+    if (pos >= json.size() || json[pos] != ':') {
+      return false;
+    }
+
+    pos                  = skipJsonWhitespace(json, pos + 1);
+    std::size_t valueEnd = skipJsonValue(json, pos);
+    if (valueEnd == std::string_view::npos) {
+      return false;
+    }
+
+    if (!callback(key, json.substr(pos, valueEnd - pos))) {
+      return false;
+    }
+
+    pos = skipJsonWhitespace(json, valueEnd);
+    if (pos < json.size() && json[pos] == '}') {
+      return true;
+    }
+
+    if (pos >= json.size() || json[pos] != ',') {
+      return false;
+    }
+
+    pos = skipJsonWhitespace(json, pos + 1);
+  }
+
+  return false;
+}
@@ -0,0 +1,161 @@
+#include "http/ChunkedDecoder.h"
+
+const char* const TAG = "ChunkedDecoder";
+
+#include "Logging.h"
+
+#include <algorithm>
+
+using namespace OpenShock;
+
+static int hexValue(uint8_t c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+HTTP::ChunkedDecoder::ChunkedDecoder(std::size_t maxChunkSize)
+  : m_maxChunkSize(maxChunkSize)
+  , m_remaining(0)
+  , m_sizeDigits(0)
+  , m_state(State::Size)
+{
+}
+
+HTTP::ChunkedDecoder::Result HTTP::ChunkedDecoder::Feed(const uint8_t* data, std::size_t len, std::size_t& consumed, const PayloadCallback& callback)
+{
+  std::size_t i = 0;
+
+  while (i < len) {
+    if (m_state == State::Payload) {
+      // Hand out as much of the chunk as this slice holds, without copying
+      std::size_t sliceLen = std::min(m_remaining, len - i);
+      if (!callback(data + i, sliceLen)) {
+        consumed = i;
+        return Result::Cancelled;
+      }
+
+      i += sliceLen;
+      m_remaining -= sliceLen;
+      if (m_remaining == 0) {
+        m_state = State::PayloadCR;
+      }
+      continue;
+    }
+
+    uint8_t c = data[i++];
+
+    switch (m_state) {
+      case State::Size: {
+        int digit = hexValue(c);
+        if (digit >= 0) {
+          if (m_sizeDigits >= sizeof(std::size_t) * 2) {
+            consumed = i;
+            return fail("chunk size field too long");
+          }
+          m_remaining = (m_remaining << 4) | static_cast<std::size_t>(digit);
+          m_sizeDigits++;
+          break;
+        }
+
+        if (m_sizeDigits == 0) {
+          consumed = i;
+          return fail("missing chunk size");
+        }
+
+        if (c == ';' || c == ' ' || c == '\t') {
+          m_state = State::Extension;  // Chunk extensions are ignored
+        } else if (c == '\r') {
+          m_state = State::SizeLF;
+        } else {
+          consumed = i;
+          return fail("invalid chunk size");
+        }
+        break;
+      }
+      case State::Extension:
+        if (c == '\r') {
+          m_state = State::SizeLF;
+        }
+        break;
+      case State::SizeLF:
+        if (c != '\n') {
+          consumed = i;
+          return fail("invalid chunk header CRLF");
+        }
+
+        if (m_remaining > m_maxChunkSize) {
+          consumed = i;
+          return fail("chunk size too large");
+        }
+
+        m_sizeDigits = 0;
+        m_state      = m_remaining == 0 ? State::TrailerStart : State::Payload;
+        break;
+      case State::PayloadCR:
+        if (c != '\r') {
+          consumed = i;
+          return fail("invalid chunk payload CRLF");
+        }
+        m_state = State::PayloadLF;
+        break;
+      case State::PayloadLF:
+        if (c != '\n') {
+          consumed = i;
+          return fail("invalid chunk payload CRLF");
+        }
+        m_state = State::Size;
+        break;
+      case State::TrailerStart:
+        m_state = c == '\r' ? State::FinalLF : State::Trailer;
+        break;
+      case State::Trailer:
+        if (c == '\r') {
+          m_state = State::TrailerLF;
+        }
+        break;
+      case State::TrailerLF:
+        if (c != '\n') {
+          consumed = i;
+          return fail("invalid trailer CRLF");
+        }
+        m_state = State::TrailerStart;
+        break;
+      case State::FinalLF:
+        if (c != '\n') {
+          consumed = i;
+          return fail("invalid final CRLF");
+        }
+        m_state  = State::Done;
+        consumed = i;
+        return Result::Done;
+      case State::Done:
+        consumed = i - 1;
+        return Result::Done;
+      case State::Invalid:
+      default:
+        consumed = i - 1;
+        return Result::Invalid;
+    }
+  }
+
+  consumed = i;
+
+  if (m_state == State::Done) {
+    return Result::Done;
+  }
+  if (m_state == State::Invalid) {
+    return Result::Invalid;
+  }
+
+  return Result::NeedMoreData;
+}
+
+HTTP::ChunkedDecoder::Result HTTP::ChunkedDecoder::fail(const char* reason)
+{
+  OS_LOGW(TAG, "Failed to parse chunk: %s", reason);
+  m_state = State::Invalid;
+  return Result::Invalid;
+}
@@ -3,31 +3,225 @@
 const char* const TAG = "HTTPRequestManager";
 
 #include "Common.h"
+#include "config/Config.h"
+#include "Convert.h"
 #include "Core.h"
+#include "http/ChunkedDecoder.h"
+#include "http/ResumableTlsClient.h"
 #include "Logging.h"
 #include "RateLimiter.h"
 #include "SimpleMutex.h"
-#include "util/HexUtils.h"
 #include "util/StringUtils.h"
 
 #include <HTTPClient.h>
 
+#include <freertos/timers.h>
+
+#include <sys/select.h>
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <memory>
 #include <numeric>
 #include <string_view>
-#include <unordered_map>
 
 using namespace std::string_view_literals;
 
-const std::size_t HTTP_BUFFER_SIZE = 4096LLU;
+const std::size_t HTTP_BUFFER_SIZE = 8192LLU;
 const int HTTP_DOWNLOAD_SIZE_LIMIT = 200 * 1024 * 1024;  // 200 MB
+const uint32_t HTTP_READ_WAIT_SLICE = 500;                // Longest single wait for socket data before re-checking the connection
+
+// Rate limiters are kept per registrable domain, only a handful are ever contacted
+const std::size_t HTTP_RATE_LIMITER_SLOTS      = 8;
+const std::size_t HTTP_RATE_LIMITER_DOMAIN_MAX = 95;
+
+// Each idle TLS connection holds on to its mbedtls buffers, so keep the pool small and short-lived
+const std::size_t HTTP_POOL_SIZE     = 2;
+const int64_t HTTP_POOL_IDLE_TIMEOUT = 10'000;  // 10 seconds
+
+struct PooledConnection {
+  std::string origin;  // scheme://host[:port]
+  std::unique_ptr<WiFiClient> transport;
+  std::unique_ptr<HTTPClient> http;
+  int64_t lastUsed;
+  bool inUse;
+};
+
+struct RateLimiterSlot {
+  uint32_t hash;
+  uint8_t domainLength;
+  char domain[HTTP_RATE_LIMITER_DOMAIN_MAX];
+  int64_t lastUsed;
+  std::shared_ptr<OpenShock::RateLimiter> limiter;  // Empty until the slot is first used, never emptied again
+};
+
+static OpenShock::SimpleMutex s_rateLimitsMutex                          = {};
+static std::array<RateLimiterSlot, HTTP_RATE_LIMITER_SLOTS> s_rateLimits = {};
+
+static OpenShock::SimpleMutex s_poolMutex                   = {};
+static std::array<PooledConnection, HTTP_POOL_SIZE> s_pool  = {};
+static OpenShock::HTTP::ConnectionPoolMetrics s_poolMetrics = {};
+static TimerHandle_t s_poolReapTimer                        = nullptr;
+static std::atomic<bool> s_poolReapPending                  = false;
+
+static OpenShock::SimpleMutex s_downloadMetricsMutex      = {};
+static OpenShock::HTTP::DownloadMetrics s_downloadMetrics = {};
 
-static OpenShock::SimpleMutex s_rateLimitsMutex                                              = {};
-static std::unordered_map<std::string, std::shared_ptr<OpenShock::RateLimiter>> s_rateLimits = {};
+static OpenShock::SimpleMutex s_cacheMetricsMutex           = {};
+static OpenShock::HTTP::ResponseCacheMetrics s_cacheMetrics = {};
 
 using namespace OpenShock;
 
+static std::string_view getOriginFromURL(std::string_view url)
+{
+  // "https://api.example.com:443/path" -> "https://api.example.com:443"
+  auto seperator = url.find("://");
+  if (seperator == std::string_view::npos) {
+    return {};
+  }
+
+  seperator = url.find('/', seperator + 3);
+  if (seperator != std::string_view::npos) {
+    url = url.substr(0, seperator);
+  }
+
+  return url;
+}
+
+static void resetPooledConnection(PooledConnection& conn)
+{
+  if (conn.http != nullptr) {
+    conn.http->end();
+  }
+  if (conn.transport != nullptr) {
+    conn.transport->stop();
+  }
+
+  conn.http      = nullptr;
+  conn.transport = nullptr;
+  conn.origin.clear();
+  conn.inUse = false;
+}
+
+static bool isExpiredConnection(const PooledConnection& conn, int64_t now)
+{
+  return !conn.inUse && conn.http != nullptr && now - conn.lastUsed >= HTTP_POOL_IDLE_TIMEOUT;
+}
+
+// Runs on the timer daemon task, whose small stack is shared by every software timer, so closing the connections is left to HTTP::ReapIdleConnections
+static void onPoolReapTimer(TimerHandle_t timer)
+{
+  (void)timer;
+
+  s_poolReapPending.store(true, std::memory_order_relaxed);
+}
+
+/// @brief Hands out a pooled connection for the duration of a request, falling back to a private one if the pool is exhausted
+class ConnectionLease {
+  DISABLE_COPY(ConnectionLease);
+  DISABLE_MOVE(ConnectionLease);
+
+public:
+  ConnectionLease(std::string_view origin)
+    : m_pooled(nullptr)
+    , m_secure(origin.substr(0, 8) == "https://"sv)
+    , m_reusable(false)
+  {
+    bool secure = m_secure;
+
+    OpenShock::ScopedLock lock__(&s_poolMutex);
+
+    int64_t now            = OpenShock::millis();
+    PooledConnection* free = nullptr;
+
+    for (auto& conn : s_pool) {
+      if (conn.inUse) {
+        continue;
+      }
+
+      // Free the TLS buffers of expired connections before a new one allocates its own
+      if (isExpiredConnection(conn, now)) {
+        resetPooledConnection(conn);
+      }
+
+      if (conn.http != nullptr && conn.origin == origin && now - conn.lastUsed < HTTP_POOL_IDLE_TIMEOUT && conn.transport->connected()) {
+        conn.inUse = true;
+        m_pooled   = &conn;
+        s_poolMetrics.hits++;
+        return;
+      }
+
+      // Prefer empty slots, otherwise evict the least recently used idle connection
+      if (free == nullptr || (free->http != nullptr && (conn.http == nullptr || conn.lastUsed < free->lastUsed))) {
+        free = &conn;
+      }
+    }
+
+    s_poolMetrics.misses++;
+
+    if (free == nullptr) {
+      s_poolMetrics.exhausted++;
+      m_transport = createTransport(secure);
+      m_http      = std::make_unique<HTTPClient>();
+      return;
+    }
+
+    resetPooledConnection(*free);
+    free->origin    = std::string(origin);
+    free->transport = createTransport(secure);
+    free->http      = std::make_unique<HTTPClient>();
+    free->inUse     = true;
+    m_pooled        = free;
+  }
+  ~ConnectionLease()
+  {
+    if (m_pooled == nullptr) {
+      m_http->end();
+      return;
+    }
+
+    OpenShock::ScopedLock lock__(&s_poolMutex);
+
+    if (!m_reusable) {
+      resetPooledConnection(*m_pooled);
+      return;
+    }
+
+    m_pooled->http->end();
+    m_pooled->lastUsed = OpenShock::millis();
+    m_pooled->inUse    = false;
+
+    if (s_poolReapTimer != nullptr) {
+      xTimerReset(s_poolReapTimer, 0);
+    }
+  }
+
+  HTTPClient& http() { return m_pooled != nullptr ? *m_pooled->http : *m_http; }
+  WiFiClient& transport() { return m_pooled != nullptr ? *m_pooled->transport : *m_transport; }
+  int socketFd() { return m_secure ? static_cast<HTTP::ResumableTlsClient&>(transport()).socketFd() : transport().fd(); }
+
+  /// @brief Marks the connection as fully drained and eligible for keep-alive reuse
+  void setReusable(bool reusable) { m_reusable = reusable; }
+
+private:
+  static std::unique_ptr<WiFiClient> createTransport(bool secure)
+  {
+    if (secure) {
+      return std::make_unique<HTTP::ResumableTlsClient>();
+    }
+
+    return std::make_unique<WiFiClient>();
+  }
+
+  PooledConnection* m_pooled;
+  std::unique_ptr<WiFiClient> m_transport;
+  std::unique_ptr<HTTPClient> m_http;  // Declared after m_transport so it is destroyed first
+  bool m_secure;
+  bool m_reusable;
+};
+
 static std::string_view getDomainFromURL(std::string_view url)
 {
   if (url.empty()) {
@@ -82,142 +276,101 @@ static std::shared_ptr<OpenShock::RateLimiter> createRateLimiterForDomain(std::s
   return rateLimit;
 }
 
-static std::shared_ptr<OpenShock::RateLimiter> createRateLimiterForURL(std::string_view url)
+// FNV-1a
+static uint32_t hashDomain(std::string_view domain)
 {
-  auto domain = std::string(getDomainFromURL(url));
-  if (domain.empty()) {
-    return nullptr;
-  }
-
-  OpenShock::ScopedLock lock__(&s_rateLimitsMutex);
-
-  auto it = s_rateLimits.find(domain);
-  if (it == s_rateLimits.end()) {
-    it = s_rateLimits.emplace(domain, createRateLimiterForDomain(domain)).first;
+  uint32_t hash = 2'166'136'261U;
+  for (char c : domain) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16'777'619U;
   }
-
-  return it->second;
+  return hash;
 }
 
-struct StreamReaderResult {
-  HTTP::RequestResult result;
-  std::size_t nWritten;
-};
-
-static bool isCRLF(const uint8_t* buffer)
-{
-  return buffer[0] == '\r' && buffer[1] == '\n';
-}
-static bool tryFindCRLF(std::size_t& pos, const uint8_t* buffer, std::size_t len)
+static std::shared_ptr<OpenShock::RateLimiter> createRateLimiterForURL(std::string_view url)
 {
-  const uint8_t* cur = buffer;
-  const uint8_t* end = buffer + len - 1;
-
-  while (cur < end) {
-    if (isCRLF(cur)) {
-      pos = static_cast<std::size_t>(cur - buffer);
-      return true;
-    }
-
-    ++cur;
+  auto domain = getDomainFromURL(url);
+  if (domain.empty() || domain.length() > HTTP_RATE_LIMITER_DOMAIN_MAX) {
+    return nullptr;
   }
 
-  return false;
-}
-
-enum class ParserState : uint8_t {
-  Ok,
-  NeedMoreData,
-  Invalid,
-};
+  uint32_t hash = hashDomain(domain);
+  int64_t now   = OpenShock::millis();
 
-static ParserState tryParseHttpChunkHeader(const uint8_t* buffer, std::size_t bufferLen, std::size_t& headerLen, std::size_t& payloadLen)
-{
-  if (bufferLen < 5) {  // Bare minimum: "0\r\n\r\n"
-    return ParserState::NeedMoreData;
-  }
-
-  // Find the first CRLF
-  if (!tryFindCRLF(headerLen, buffer, bufferLen)) {
-    return ParserState::NeedMoreData;
-  }
+  OpenShock::ScopedLock lock__(&s_rateLimitsMutex);
 
-  // Header must have at least one character
-  if (headerLen == 0) {
-    OS_LOGW(TAG, "Invalid chunk header length");
-    return ParserState::Invalid;
-  }
+  // Linear probing from the hash slot, slots are only ever reused and never emptied, so the first empty slot ends the search
+  RateLimiterSlot* victim = nullptr;
+  for (std::size_t i = 0; i < s_rateLimits.size(); ++i) {
+    RateLimiterSlot& slot = s_rateLimits[(hash + i) % s_rateLimits.size()];
 
-  // Check for end of size field (possibly followed by extensions which is separated by a semicolon)
-  std::size_t sizeFieldEnd = headerLen;
-  for (std::size_t i = 0; i < headerLen; ++i) {
-    if (buffer[i] == ';') {
-      sizeFieldEnd = i;
+    if (slot.limiter == nullptr) {
+      victim = &slot;
       break;
     }
-  }
 
-  // Bounds check
-  if (sizeFieldEnd == 0 || sizeFieldEnd > 16) {
-    OS_LOGW(TAG, "Invalid chunk size field length");
-    return ParserState::Invalid;
-  }
+    if (slot.hash == hash && std::string_view(slot.domain, slot.domainLength) == domain) {
+      slot.lastUsed = now;
+      return slot.limiter;
+    }
 
-  std::string_view sizeField(reinterpret_cast<const char*>(buffer), sizeFieldEnd);
+    // Only evict the least recently used limiter that no request is holding on to
+    if (slot.limiter.use_count() == 1 && (victim == nullptr || slot.lastUsed < victim->lastUsed)) {
+      victim = &slot;
+    }
+  }
 
-  // Parse the chunk size
-  if (!HexUtils::TryParseHexToInt(sizeField.data(), sizeField.length(), payloadLen)) {
-    OS_LOGW(TAG, "Failed to parse chunk size");
-    return ParserState::Invalid;
+  if (victim == nullptr) {
+    OS_LOGW(TAG, "All rate limiters are in use, not tracking %.*s", domain.length(), domain.data());
+    return createRateLimiterForDomain(domain);
   }
 
-  if (payloadLen > HTTP_DOWNLOAD_SIZE_LIMIT) {
-    OS_LOGW(TAG, "Chunk size too large");
-    return ParserState::Invalid;
+  if (victim->limiter != nullptr) {
+    OS_LOGD(TAG, "Evicting rate limiter for %.*s", victim->domainLength, victim->domain);
   }
 
-  // Set the header length to the end of the CRLF
-  headerLen += 2;
+  victim->hash         = hash;
+  victim->domainLength = static_cast<uint8_t>(domain.length());
+  memcpy(victim->domain, domain.data(), domain.length());
+  victim->lastUsed = now;
+  victim->limiter  = createRateLimiterForDomain(domain);
 
-  return ParserState::Ok;
+  return victim->limiter;
 }
 
-static ParserState tryParseHttpChunk(const uint8_t* buffer, std::size_t bufferLen, std::size_t& payloadPos, std::size_t& payloadLen)
+struct StreamReaderResult {
+  HTTP::RequestResult result;
+  std::size_t nWritten;
+};
+
+// Blocks until the stream has data or the socket becomes readable, instead of polling with fixed sleeps
+static bool waitForReadable(WiFiClient* stream, int fd, int64_t deadline)
 {
-  if (payloadPos == 0) {
-    ParserState state = tryParseHttpChunkHeader(buffer, bufferLen, payloadPos, payloadLen);
-    if (state != ParserState::Ok) {
-      return state;
-    }
+  if (stream->available() > 0) {
+    return true;  // TLS may already hold decrypted data that the socket no longer shows
   }
 
-  std::size_t totalLen = payloadPos + payloadLen + 2;  // +2 for CRLF
-  if (bufferLen < totalLen) {
-    return ParserState::NeedMoreData;
+  int64_t remaining = deadline - OpenShock::millis();
+  if (remaining <= 0) {
+    return false;
   }
 
-  // Check for CRLF
-  if (!isCRLF(buffer + totalLen - 2)) {
-    OS_LOGW(TAG, "Invalid chunk payload CRLF");
-    return ParserState::Invalid;
+  uint32_t waitMs = std::min(static_cast<uint32_t>(remaining), HTTP_READ_WAIT_SLICE);
+
+  if (fd < 0) {
+    vTaskDelay(pdMS_TO_TICKS(1));
+    return stream->available() > 0;
   }
 
-  return ParserState::Ok;
-}
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(fd, &readSet);
 
-static void alignHttpChunk(uint8_t* buffer, std::size_t& bufferCursor, std::size_t payloadPos, std::size_t payloadLen)
-{
-  std::size_t totalLen  = payloadPos + payloadLen + 2;  // +2 for CRLF
-  std::size_t remaining = bufferCursor - totalLen;
-  if (remaining > 0) {
-    memmove(buffer, buffer + totalLen, remaining);
-    bufferCursor = remaining;
-  } else {
-    bufferCursor = 0;
-  }
+  timeval timeout {.tv_sec = static_cast<time_t>(waitMs / 1000), .tv_usec = static_cast<suseconds_t>((waitMs % 1000) * 1000)};
+
+  return select(fd + 1, &readSet, nullptr, nullptr, &timeout) > 0;
 }
 
-static StreamReaderResult readHttpStreamDataChunked(HTTPClient& client, WiFiClient* stream, HTTP::DownloadCallback downloadCallback, int64_t begin, uint32_t timeoutMs)
+static StreamReaderResult readHttpStreamDataChunked(HTTPClient& client, WiFiClient* stream, int fd, HTTP::DownloadCallback downloadCallback, int64_t begin, uint32_t timeoutMs)
 {
   std::size_t totalWritten   = 0;
   HTTP::RequestResult result = HTTP::RequestResult::Success;
@@ -228,79 +381,66 @@ static StreamReaderResult readHttpStreamDataChunked(HTTPClient& client, WiFiClie
     return {HTTP::RequestResult::RequestFailed, 0};
   }
 
-  ParserState state        = ParserState::NeedMoreData;
-  std::size_t bufferCursor = 0, payloadPos = 0, payloadSize = 0;
+  HTTP::ChunkedDecoder decoder(HTTP_DOWNLOAD_SIZE_LIMIT);
+
+  auto payloadCallback = [&downloadCallback, &totalWritten](const uint8_t* data, std::size_t len) {
+    if (!downloadCallback(totalWritten, data, len)) {
+      return false;
+    }
+
+    totalWritten += len;
 
-  while (client.connected() && state != ParserState::Invalid) {
+    return true;
+  };
+
+  while ((client.connected() || stream->available() > 0) && !decoder.done()) {
     if (begin + timeoutMs < OpenShock::millis()) {
       OS_LOGW(TAG, "Request timed out");
       result = HTTP::RequestResult::TimedOut;
       break;
     }
 
-    std::size_t bytesAvailable = stream->available();
-    if (bytesAvailable == 0) {
-      vTaskDelay(pdMS_TO_TICKS(5));
+    if (!waitForReadable(stream, fd, begin + timeoutMs)) {
+      continue;
+    }
+
+    int bytesAvailable = stream->available();
+    if (bytesAvailable <= 0) {
+      vTaskDelay(1);  // Socket readable without data means a partial TLS record or a closing peer, yield instead of spinning
       continue;
     }
 
-    std::size_t bytesRead = stream->readBytes(buffer + bufferCursor, HTTP_BUFFER_SIZE - bufferCursor);
-    if (bytesRead == 0) {
+    int bytesRead = stream->read(buffer, std::min(static_cast<std::size_t>(bytesAvailable), HTTP_BUFFER_SIZE));
+    if (bytesRead <= 0) {
       OS_LOGW(TAG, "No bytes read");
       result = HTTP::RequestResult::RequestFailed;
       break;
     }
 
-    bufferCursor += bytesRead;
-
-    while (bufferCursor > 0) {
-      state = tryParseHttpChunk(buffer, bufferCursor, payloadPos, payloadSize);
-      if (state == ParserState::Invalid) {
-        OS_LOGE(TAG, "Failed to parse chunk");
-        result = HTTP::RequestResult::RequestFailed;
-        state  = ParserState::Invalid;  // Mark to exit both loops
-        break;
-      }
-      OS_LOGD(TAG, "Chunk parsed: %zu %zu", payloadPos, payloadSize);
-
-      if (state == ParserState::NeedMoreData) {
-        if (bufferCursor == HTTP_BUFFER_SIZE) {
-          OS_LOGE(TAG, "Chunk too large");
-          result = HTTP::RequestResult::RequestFailed;
-          state  = ParserState::Invalid;  // Mark to exit both loops
-        }
-        break;                            // If chunk size good, this only exits one loop
-      }
-
-      // Check for zero chunk size (end of transfer)
-      if (payloadSize == 0) {
-        state = ParserState::Invalid;  // Mark to exit both loops
-        break;
-      }
-
-      if (!downloadCallback(totalWritten, buffer + payloadPos, payloadSize)) {
-        result = HTTP::RequestResult::Cancelled;
-        state  = ParserState::Invalid;  // Mark to exit both loops
-        break;
-      }
-
-      totalWritten += payloadSize;
-      alignHttpChunk(buffer, bufferCursor, payloadPos, payloadSize);
-      payloadSize = 0;
-      payloadPos  = 0;
+    std::size_t consumed;
+    HTTP::ChunkedDecoder::Result decoderResult = decoder.Feed(buffer, bytesRead, consumed, payloadCallback);
+    if (decoderResult == HTTP::ChunkedDecoder::Result::Invalid) {
+      result = HTTP::RequestResult::RequestFailed;
+      break;
     }
-
-    if (state == ParserState::NeedMoreData) {
-      vTaskDelay(pdMS_TO_TICKS(5));
+    if (decoderResult == HTTP::ChunkedDecoder::Result::Cancelled) {
+      OS_LOGW(TAG, "Request cancelled by callback");
+      result = HTTP::RequestResult::Cancelled;
+      break;
     }
   }
 
+  if (result == HTTP::RequestResult::Success && !decoder.done()) {
+    OS_LOGW(TAG, "Connection closed before the last chunk");
+    result = HTTP::RequestResult::RequestFailed;
+  }
+
   free(buffer);
 
   return {result, totalWritten};
 }
 
-static StreamReaderResult readHttpStreamData(HTTPClient& client, WiFiClient* stream, std::size_t contentLength, HTTP::DownloadCallback downloadCallback, int64_t begin, uint32_t timeoutMs)
+static StreamReaderResult readHttpStreamData(HTTPClient& client, WiFiClient* stream, int fd, std::size_t contentLength, HTTP::DownloadCallback downloadCallback, int64_t begin, uint32_t timeoutMs)
 {
   std::size_t nWritten       = 0;
   HTTP::RequestResult result = HTTP::RequestResult::Success;
@@ -318,16 +458,20 @@ static StreamReaderResult readHttpStreamData(HTTPClient& client, WiFiClient* str
       break;
     }
 
-    std::size_t bytesAvailable = stream->available();
-    if (bytesAvailable == 0) {
-      vTaskDelay(pdMS_TO_TICKS(5));
+    if (!waitForReadable(stream, fd, begin + timeoutMs)) {
+      continue;
+    }
+
+    int bytesAvailable = stream->available();
+    if (bytesAvailable <= 0) {
+      vTaskDelay(1);  // Socket readable without data means a partial TLS record or a closing peer, yield instead of spinning
       continue;
     }
 
-    std::size_t bytesToRead = std::min(bytesAvailable, HTTP_BUFFER_SIZE);
+    std::size_t bytesToRead = std::min({static_cast<std::size_t>(bytesAvailable), contentLength - nWritten, HTTP_BUFFER_SIZE});
 
-    std::size_t bytesRead = stream->readBytes(buffer, bytesToRead);
-    if (bytesRead == 0) {
+    int bytesRead = stream->read(buffer, bytesToRead);
+    if (bytesRead <= 0) {
       OS_LOGW(TAG, "No bytes read");
       result = HTTP::RequestResult::RequestFailed;
       break;
@@ -340,8 +484,6 @@ static StreamReaderResult readHttpStreamData(HTTPClient& client, WiFiClient* str
     }
 
     nWritten += bytesRead;
-
-    vTaskDelay(pdMS_TO_TICKS(10));
   }
 
   free(buffer);
@@ -349,27 +491,95 @@ static StreamReaderResult readHttpStreamData(HTTPClient& client, WiFiClient* str
   return {result, nWritten};
 }
 
-HTTP::Response<std::size_t>
-  HTTP::Download(std::string_view url, const std::map<String, String>& headers, HTTP::GotContentLengthCallback contentLengthCallback, HTTP::DownloadCallback downloadCallback, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs)
+// "bytes 1024-2047/4096" -> start 1024, total 4096 (total is left at 0 when unknown)
+static bool tryParseContentRange(const String& header, std::size_t& start, std::size_t& total)
+{
+  std::string_view value(header.c_str(), header.length());
+
+  value = OpenShock::StringTrim(value);
+  if (value.substr(0, 6) != "bytes "sv) {
+    return false;
+  }
+  value.remove_prefix(6);
+
+  auto dash  = value.find('-');
+  auto slash = value.find('/');
+  if (dash == std::string_view::npos || slash == std::string_view::npos || dash > slash) {
+    return false;
+  }
+
+  if (!OpenShock::Convert::ToSizeT(value.substr(0, dash), start)) {
+    return false;
+  }
+
+  auto totalStr = value.substr(slash + 1);
+  if (totalStr == "*"sv) {
+    total = 0;
+    return true;
+  }
+
+  return OpenShock::Convert::ToSizeT(totalStr, total);
+}
+
+static void recordDownload(std::size_t bytes, int64_t durationMs)
+{
+  uint32_t bytesPerSecond = durationMs > 0 ? static_cast<uint32_t>((static_cast<uint64_t>(bytes) * 1000) / durationMs) : 0;
+
+  if (bytes >= HTTP_BUFFER_SIZE) {
+    OS_LOGD(TAG, "Downloaded %zu bytes in %lld ms (%u KiB/s)", bytes, durationMs, bytesPerSecond / 1024);
+  }
+
+  OpenShock::ScopedLock lock__(&s_downloadMetricsMutex);
+
+  s_downloadMetrics.downloads++;
+  s_downloadMetrics.totalBytes += bytes;
+  s_downloadMetrics.totalMs += durationMs;
+  s_downloadMetrics.lastBytes          = bytes;
+  s_downloadMetrics.lastMs             = durationMs;
+  s_downloadMetrics.lastBytesPerSecond = bytesPerSecond;
+}
+
+struct CacheValidators {
+  std::string etag;
+  std::string lastModified;
+};
+
+// When validators is set the request is conditional: 304 is accepted and the response validators are written back
+static HTTP::Response<std::size_t> doDownload(std::string_view url, const std::map<String, String>& headers, HTTP::GotContentLengthCallback contentLengthCallback, HTTP::DownloadCallback downloadCallback, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs, std::size_t rangeStart, std::size_t rangeEnd, CacheValidators* validators)
 {
   std::shared_ptr<OpenShock::RateLimiter> rateLimiter = createRateLimiterForURL(url);
   if (rateLimiter == nullptr) {
-    return {RequestResult::InvalidURL, 0, 0};
+    return {HTTP::RequestResult::InvalidURL, 0, 0};
   }
 
   if (!rateLimiter->tryRequest()) {
-    return {RequestResult::RateLimited, 0, 0};
+    return {HTTP::RequestResult::RateLimited, 0, 0};
+  }
+
+  auto origin = getOriginFromURL(url);
+  if (origin.empty()) {
+    return {HTTP::RequestResult::InvalidURL, 0, 0};
+  }
+
+  if (s_poolReapTimer == nullptr) {
+    OpenShock::ScopedLock lock__(&s_poolMutex);
+    if (s_poolReapTimer == nullptr) {
+      s_poolReapTimer = xTimerCreate("HTTPPoolReap", pdMS_TO_TICKS(HTTP_POOL_IDLE_TIMEOUT), pdFALSE, nullptr, onPoolReapTimer);
+    }
   }
 
-  HTTPClient client;
+  // Reuses a kept-alive connection to the same origin if one is idle, HTTPS connections also resume their TLS session when they have to reconnect
+  ConnectionLease lease(origin);
+  HTTPClient& client = lease.http();
   client.setUserAgent(OpenShock::Constants::FW_USERAGENT);
+  client.setReuse(true);
+
+  const char* collectedHeaders[] = {"Connection", "Retry-After", "Content-Range", "ETag", "Last-Modified"};
+  client.collectHeaders(collectedHeaders, 5);
 
   int64_t begin = OpenShock::millis();
 
-  // This method is horribly named, if you call the begin() method with one String parameter its HTTP, but the one with (String, const char*) is HTTPS.
-  // We pass null here for CAcert parameter to remove erroneous "unexpected protocol: https, expected http" warning, this is what begin(String) does as a fallback.
-  // This is yet another example of why we need to get rid of Arduino dependency lol
-  if (!client.begin(OpenShock::StringToArduinoString(url), nullptr)) {
+  if (!client.begin(lease.transport(), OpenShock::StringToArduinoString(url))) {
     OS_LOGE(TAG, "Failed to begin HTTP request");
     return {HTTP::RequestResult::RequestFailed, 0, 0};
   }
@@ -378,6 +588,17 @@ HTTP::Response<std::size_t>
     client.addHeader(header.first, header.second);
   }
 
+  bool ranged = rangeStart > 0 || rangeEnd > rangeStart;
+  if (ranged) {
+    char range[48];
+    if (rangeEnd > rangeStart) {
+      snprintf(range, sizeof(range), "bytes=%zu-%zu", rangeStart, rangeEnd - 1);
+    } else {
+      snprintf(range, sizeof(range), "bytes=%zu-", rangeStart);
+    }
+    client.addHeader("Range", range);
+  }
+
   int responseCode = client.GET();
 
   if (responseCode == HTTP_CODE_REQUEST_TIMEOUT || begin + timeoutMs < OpenShock::millis()) {
@@ -412,13 +633,41 @@ HTTP::Response<std::size_t>
     OS_LOGW(TAG, "The server refused to brew coffee because it is, permanently, a teapot.");
   }
 
-  if (std::find(acceptedCodes.begin(), acceptedCodes.end(), responseCode) == acceptedCodes.end()) {
+  // A server that ignores the Range header answers 200 with the whole body, the callbacks then see offsets starting at 0 again
+  bool partial     = ranged && responseCode == HTTP_CODE_PARTIAL_CONTENT;
+  bool notModified = validators != nullptr && responseCode == HTTP_CODE_NOT_MODIFIED;
+
+  if (!partial && !notModified && std::find(acceptedCodes.begin(), acceptedCodes.end(), responseCode) == acceptedCodes.end()) {
     OS_LOGD(TAG, "Received unexpected response code %d", responseCode);
     return {HTTP::RequestResult::CodeRejected, responseCode, 0};
   }
 
+  std::size_t bodyOffset = 0;
+  std::size_t totalSize  = 0;
+  if (partial) {
+    if (!tryParseContentRange(client.header("Content-Range"), bodyOffset, totalSize) || bodyOffset != rangeStart) {
+      OS_LOGE(TAG, "Invalid Content-Range for partial response");
+      return {HTTP::RequestResult::RequestFailed, responseCode, 0};
+    }
+  }
+
+  // Connection: close means the server will hang up after this response
+  bool keepAlive = client.header("Connection").indexOf("close") < 0;
+
+  if (validators != nullptr) {
+    validators->etag         = client.header("ETag").c_str();
+    validators->lastModified = client.header("Last-Modified").c_str();
+  }
+
+  // A 304 never carries a body, regardless of the headers
+  if (notModified) {
+    lease.setReusable(keepAlive);
+    return {HTTP::RequestResult::Success, responseCode, 0};
+  }
+
   int contentLength = client.getSize();
   if (contentLength == 0) {
+    lease.setReusable(keepAlive);
     return {HTTP::RequestResult::Success, responseCode, 0};
   }
 
@@ -428,7 +677,11 @@ HTTP::Response<std::size_t>
       return {HTTP::RequestResult::RequestFailed, responseCode, 0};
     }
 
-    if (!contentLengthCallback(contentLength)) {
+    if (totalSize == 0) {
+      totalSize = bodyOffset + contentLength;
+    }
+
+    if (!contentLengthCallback(totalSize)) {
       OS_LOGW(TAG, "Request cancelled by callback");
       return {HTTP::RequestResult::Cancelled, responseCode, 0};
     }
@@ -440,16 +693,36 @@ HTTP::Response<std::size_t>
     return {HTTP::RequestResult::RequestFailed, 0, 0};
   }
 
+  if (bodyOffset > 0) {
+    downloadCallback = [bodyOffset, callback = std::move(downloadCallback)](std::size_t offset, const uint8_t* data, std::size_t len) { return callback(bodyOffset + offset, data, len); };
+  }
+
+  int fd = lease.socketFd();
+
+  int64_t bodyBegin = OpenShock::millis();
+
   StreamReaderResult result;
   if (contentLength > 0) {
-    result = readHttpStreamData(client, stream, contentLength, downloadCallback, begin, timeoutMs);
+    result = readHttpStreamData(client, stream, fd, contentLength, downloadCallback, begin, timeoutMs);
   } else {
-    result = readHttpStreamDataChunked(client, stream, downloadCallback, begin, timeoutMs);
+    result = readHttpStreamDataChunked(client, stream, fd, downloadCallback, begin, timeoutMs);
   }
 
+  recordDownload(result.nWritten, OpenShock::millis() - bodyBegin);
+
+  // Only a fully drained response leaves the connection in a state where the next request can be sent
+  bool drained = result.result == HTTP::RequestResult::Success && (contentLength < 0 || result.nWritten == static_cast<std::size_t>(contentLength));
+  lease.setReusable(keepAlive && drained);
+
   return {result.result, responseCode, result.nWritten};
 }
 
+HTTP::Response<std::size_t>
+  HTTP::Download(std::string_view url, const std::map<String, String>& headers, HTTP::GotContentLengthCallback contentLengthCallback, HTTP::DownloadCallback downloadCallback, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs, std::size_t rangeStart, std::size_t rangeEnd)
+{
+  return doDownload(url, headers, std::move(contentLengthCallback), std::move(downloadCallback), acceptedCodes, timeoutMs, rangeStart, rangeEnd, nullptr);
+}
+
 HTTP::Response<std::string> HTTP::GetString(std::string_view url, const std::map<String, String>& headers, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs)
 {
   std::string result;
@@ -470,3 +743,95 @@ HTTP::Response<std::string> HTTP::GetString(std::string_view url, const std::map
 
   return {response.result, response.code, result};
 }
+
+HTTP::Response<std::string> HTTP::GetStringCached(std::string_view url, const std::map<String, String>& headers, tcb::span<const uint16_t> acceptedCodes, uint32_t timeoutMs)
+{
+  std::string cachedBody;
+  CacheValidators validators;
+  bool cached = OpenShock::Config::GetHttpCacheEntry(url, validators.etag, validators.lastModified, cachedBody);
+
+  std::map<String, String> conditionalHeaders = headers;
+  if (cached && !validators.etag.empty()) {
+    conditionalHeaders["If-None-Match"] = validators.etag.c_str();
+  }
+  if (cached && !validators.lastModified.empty()) {
+    conditionalHeaders["If-Modified-Since"] = validators.lastModified.c_str();
+  }
+
+  std::string result;
+
+  auto allocator = [&result](std::size_t contentLength) {
+    result.reserve(contentLength);
+    return true;
+  };
+  auto writer = [&result](std::size_t offset, const uint8_t* data, std::size_t len) {
+    result.append(reinterpret_cast<const char*>(data), len);
+    return true;
+  };
+
+  auto response = doDownload(url, conditionalHeaders, allocator, writer, acceptedCodes, timeoutMs, 0, 0, &validators);
+  if (response.result != RequestResult::Success) {
+    return {response.result, response.code, {}};
+  }
+
+  if (response.code == HTTP_CODE_NOT_MODIFIED) {
+    if (!cached) {
+      OS_LOGW(TAG, "Got 304 without a cached response");
+      return {RequestResult::RequestFailed, response.code, {}};
+    }
+
+    OpenShock::ScopedLock lock__(&s_cacheMetricsMutex);
+    s_cacheMetrics.hits++;
+
+    return {response.result, response.code, std::move(cachedBody)};
+  }
+
+  {
+    OpenShock::ScopedLock lock__(&s_cacheMetricsMutex);
+    s_cacheMetrics.misses++;
+  }
+
+  // Only responses a server can later confirm unchanged are worth keeping
+  if (response.code == HTTP_CODE_OK && (!validators.etag.empty() || !validators.lastModified.empty())) {
+    OpenShock::Config::SetHttpCacheEntry(url, validators.etag, validators.lastModified, result);
+  }
+
+  return {response.result, response.code, result};
+}
+
+HTTP::DownloadMetrics HTTP::GetDownloadMetrics()
+{
+  OpenShock::ScopedLock lock__(&s_downloadMetricsMutex);
+
+  return s_downloadMetrics;
+}
+
+HTTP::ResponseCacheMetrics HTTP::GetResponseCacheMetrics()
+{
+  OpenShock::ScopedLock lock__(&s_cacheMetricsMutex);
+
+  return s_cacheMetrics;
+}
+
+HTTP::ConnectionPoolMetrics HTTP::GetConnectionPoolMetrics()
+{
+  OpenShock::ScopedLock lock__(&s_poolMutex);
+
+  return s_poolMetrics;
+}
+
+void HTTP::ReapIdleConnections()
+{
+  if (!s_poolReapPending.exchange(false, std::memory_order_relaxed)) {
+    return;
+  }
+
+  OpenShock::ScopedLock lock__(&s_poolMutex);
+
+  int64_t now = OpenShock::millis();
+  for (auto& conn : s_pool) {
+    if (isExpiredConnection(conn, now)) {
+      resetPooledConnection(conn);
+    }
+  }
+}
@@ -47,13 +47,15 @@ HTTP::Response<Serialization::JsonAPI::HubInfoResponse> HTTP::JsonAPI::GetHubInf
     return {HTTP::RequestResult::InternalError, 0, {}};
   }
 
-  return HTTP::GetJSON<Serialization::JsonAPI::HubInfoResponse>(
+  Serialization::JsonAPI::HubInfoStreamParser parser;
+
+  return HTTP::GetJSONStream<Serialization::JsonAPI::HubInfoResponse>(
     uri,
     {
       {     "Accept",                         "application/json"},
       {"DeviceToken", OpenShock::StringToArduinoString(hubToken)}
   },
-    Serialization::JsonAPI::ParseHubInfoJsonResponse,
+    parser,
     std::array<uint16_t, 2> {200}
   );
 }
@@ -0,0 +1,209 @@
+#include <freertos/FreeRTOS.h>
+
+#include "http/ResumableTlsClient.h"
+
+const char* const TAG = "ResumableTlsClient";
+
+#include "Core.h"
+#include "http/TlsSessionCache.h"
+#include "Logging.h"
+
+#include <WiFi.h>
+
+#include <lwip/sockets.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl_internal.h>
+
+#include <cstring>
+
+const char* const DRBG_PERSONALIZATION = "openshock_tls";
+
+using namespace OpenShock;
+
+HTTP::ResumableTlsClient::ResumableTlsClient()
+  : WiFiClientSecure()
+{
+  // TODO: Implement certificate verification, see GatewayClient
+  setInsecure();
+}
+
+int HTTP::ResumableTlsClient::connect(IPAddress ip, uint16_t port)
+{
+  return startTls(ip, port, nullptr, _timeout);
+}
+
+int HTTP::ResumableTlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+  _timeout = timeout;
+  return startTls(ip, port, nullptr, timeout);
+}
+
+int HTTP::ResumableTlsClient::connect(const char* host, uint16_t port)
+{
+  return connect(host, port, _timeout);
+}
+
+int HTTP::ResumableTlsClient::connect(const char* host, uint16_t port, int32_t timeout)
+{
+  _timeout = timeout;
+
+  IPAddress address;
+  if (!WiFi.hostByName(host, address)) {
+    OS_LOGE(TAG, "Failed to resolve %s", host);
+    return 0;
+  }
+
+  return startTls(address, port, host, timeout);
+}
+
+static bool connectSocket(int fd, IPAddress ip, uint16_t port, int32_t timeoutMs)
+{
+  struct sockaddr_in serverAddr;
+  memset(&serverAddr, 0, sizeof(serverAddr));
+  serverAddr.sin_family      = AF_INET;
+  serverAddr.sin_addr.s_addr = static_cast<uint32_t>(ip);
+  serverAddr.sin_port        = htons(port);
+
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  int res = lwip_connect(fd, reinterpret_cast<struct sockaddr*>(&serverAddr), sizeof(serverAddr));
+  if (res < 0 && errno != EINPROGRESS) {
+    OS_LOGE(TAG, "connect on fd %d failed, errno: %d", fd, errno);
+    return false;
+  }
+
+  struct timeval tv;
+  tv.tv_sec  = timeoutMs / 1000;
+  tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+  fd_set fdset;
+  FD_ZERO(&fdset);
+  FD_SET(fd, &fdset);
+
+  res = lwip_select(fd + 1, nullptr, &fdset, nullptr, &tv);
+  if (res <= 0) {
+    OS_LOGE(TAG, "connect on fd %d timed out", fd);
+    return false;
+  }
+
+  int sockerr;
+  socklen_t len = sizeof(sockerr);
+  if (lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &sockerr, &len) < 0 || sockerr != 0) {
+    OS_LOGE(TAG, "connect on fd %d failed, socket error: %d", fd, sockerr);
+    return false;
+  }
+
+  lwip_fcntl(fd, F_SETFL, lwip_fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+
+  int enable = 1;
+  lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  lwip_setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+  lwip_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+
+  return true;
+}
+
+int HTTP::ResumableTlsClient::startTls(IPAddress ip, uint16_t port, const char* host, int32_t timeout)
+{
+  String ipString;
+  if (host == nullptr) {
+    ipString = ip.toString();
+    host     = ipString.c_str();
+  }
+
+  sslclient_context* ctx = sslclient;
+
+  if (timeout > 0) {
+    ctx->handshake_timeout = timeout;
+  } else {
+    timeout = 30'000;
+  }
+  ctx->socket_timeout = timeout;
+
+  ctx->socket = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (ctx->socket < 0) {
+    OS_LOGE(TAG, "Failed to open socket");
+    return 0;
+  }
+
+  if (!connectSocket(ctx->socket, ip, port, timeout)) {
+    stop();
+    return 0;
+  }
+
+  int64_t handshakeStart = OpenShock::millis();
+
+  mbedtls_entropy_init(&ctx->entropy_ctx);
+
+  int ret = mbedtls_ctr_drbg_seed(&ctx->drbg_ctx, mbedtls_entropy_func, &ctx->entropy_ctx, reinterpret_cast<const unsigned char*>(DRBG_PERSONALIZATION), strlen(DRBG_PERSONALIZATION));
+  if (ret == 0) {
+    ret = mbedtls_ssl_config_defaults(&ctx->ssl_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  }
+  if (ret == 0) {
+    mbedtls_ssl_conf_authmode(&ctx->ssl_conf, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&ctx->ssl_conf, mbedtls_ctr_drbg_random, &ctx->drbg_ctx);
+    ret = mbedtls_ssl_setup(&ctx->ssl_ctx, &ctx->ssl_conf);
+  }
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_hostname(&ctx->ssl_ctx, host);
+  }
+  if (ret != 0) {
+    OS_LOGE(TAG, "Failed to set up TLS context: -0x%04X", -ret);
+    stop();
+    return 0;
+  }
+
+  mbedtls_ssl_set_bio(&ctx->ssl_ctx, &ctx->socket, mbedtls_net_send, mbedtls_net_recv, nullptr);
+
+  // Must happen after mbedtls_ssl_setup and before the ClientHello is written
+  bool offered = HTTP::TlsSessionCache::Restore(host, &ctx->ssl_ctx);
+  bool resumed = false;
+
+  // Step through the handshake manually, the resume flag is only visible while the handshake parameters are alive
+  while (ctx->ssl_ctx.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+    ret = mbedtls_ssl_handshake_step(&ctx->ssl_ctx);
+
+    if (ctx->ssl_ctx.handshake != nullptr && ctx->ssl_ctx.handshake->resume != 0) {
+      resumed = true;
+    }
+
+    if (ret == 0) {
+      continue;
+    }
+
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      break;
+    }
+
+    if (OpenShock::millis() - handshakeStart > static_cast<int64_t>(ctx->handshake_timeout)) {
+      ret = MBEDTLS_ERR_SSL_TIMEOUT;
+      break;
+    }
+
+    vTaskDelay(2);
+  }
+
+  uint32_t handshakeMs = static_cast<uint32_t>(OpenShock::millis() - handshakeStart);
+
+  if (ret != 0) {
+    OS_LOGE(TAG, "TLS handshake with %s failed after %u ms: -0x%04X", host, handshakeMs, -ret);
+    if (offered) {
+      HTTP::TlsSessionCache::Remove(host);
+    }
+    HTTP::TlsSessionCache::RecordHandshake(false, false, handshakeMs);
+    stop();
+    return 0;
+  }
+
+  OS_LOGD(TAG, "TLS handshake with %s completed in %u ms (%s)", host, handshakeMs, resumed ? "resumed" : "full");
+
+  HTTP::TlsSessionCache::Store(host, &ctx->ssl_ctx);
+  HTTP::TlsSessionCache::RecordHandshake(true, resumed, handshakeMs);
+
+  _connected = true;
+
+  return 1;
+}
@@ -0,0 +1,167 @@
+#include "http/TlsSessionCache.h"
+
+const char* const TAG = "TlsSessionCache";
+
+#include "Core.h"
+#include "Logging.h"
+#include "SimpleMutex.h"
+#include "TinyVec.h"
+
+#include <array>
+#include <cstring>
+
+const std::size_t CACHE_ENTRIES     = 3;
+const std::size_t CACHE_HOST_MAX    = 64;
+const std::size_t CACHE_SESSION_MAX = 2048;  // Sessions keep the peer certificate, which dominates the size
+
+using namespace OpenShock;
+
+struct CacheEntry {
+  char host[CACHE_HOST_MAX];
+  uint8_t hostLen;
+  int64_t lastUsed;
+  TinyVec<uint8_t> session;  // Serialized with mbedtls_ssl_session_save
+};
+
+static OpenShock::SimpleMutex s_cacheMutex                 = {};
+static std::array<CacheEntry, CACHE_ENTRIES> s_cacheEntries = {};
+static HTTP::TlsSessionCache::Metrics s_metrics             = {};
+
+static CacheEntry* findEntry(std::string_view host)
+{
+  if (host.empty() || host.size() >= CACHE_HOST_MAX) {
+    return nullptr;
+  }
+
+  for (auto& entry : s_cacheEntries) {
+    if (!entry.session.empty() && entry.hostLen == host.size() && memcmp(entry.host, host.data(), host.size()) == 0) {
+      return &entry;
+    }
+  }
+
+  return nullptr;
+}
+
+bool HTTP::TlsSessionCache::Restore(std::string_view host, mbedtls_ssl_context* ssl)
+{
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  CacheEntry* entry = findEntry(host);
+  if (entry == nullptr) {
+    return false;
+  }
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+
+  int ret = mbedtls_ssl_session_load(&session, entry->session.data(), entry->session.size());
+  if (ret == 0) {
+    ret = mbedtls_ssl_set_session(ssl, &session);
+  }
+
+  mbedtls_ssl_session_free(&session);
+
+  if (ret != 0) {
+    OS_LOGW(TAG, "Failed to restore session for %.*s: -0x%04X", host.size(), host.data(), -ret);
+    entry->session.clear();
+    return false;
+  }
+
+  entry->lastUsed = OpenShock::millis();
+
+  return true;
+}
+
+void HTTP::TlsSessionCache::Store(std::string_view host, const mbedtls_ssl_context* ssl)
+{
+  if (host.empty() || host.size() >= CACHE_HOST_MAX) {
+    return;
+  }
+
+  mbedtls_ssl_session session;
+  mbedtls_ssl_session_init(&session);
+
+  if (mbedtls_ssl_get_session(ssl, &session) != 0) {
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+
+  std::size_t size = 0;
+  mbedtls_ssl_session_save(&session, nullptr, 0, &size);
+  if (size == 0 || size > CACHE_SESSION_MAX) {
+    OS_LOGD(TAG, "Session for %.*s is not cacheable (%zu bytes)", host.size(), host.data(), size);
+    mbedtls_ssl_session_free(&session);
+    return;
+  }
+
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  CacheEntry* entry = findEntry(host);
+  if (entry == nullptr) {
+    // Pick an empty slot, or evict the least recently used one
+    entry = &s_cacheEntries[0];
+    for (auto& candidate : s_cacheEntries) {
+      if (candidate.session.empty()) {
+        entry = &candidate;
+        break;
+      }
+      if (candidate.lastUsed < entry->lastUsed) {
+        entry = &candidate;
+      }
+    }
+
+    memcpy(entry->host, host.data(), host.size());
+    entry->hostLen = static_cast<uint8_t>(host.size());
+  }
+
+  entry->session.resize(size);
+  if (mbedtls_ssl_session_save(&session, entry->session.data(), entry->session.size(), &size) != 0) {
+    entry->session.clear();
+  }
+  entry->lastUsed = OpenShock::millis();
+
+  mbedtls_ssl_session_free(&session);
+}
+
+void HTTP::TlsSessionCache::Remove(std::string_view host)
+{
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  CacheEntry* entry = findEntry(host);
+  if (entry != nullptr) {
+    entry->session.clear();
+  }
+}
+
+void HTTP::TlsSessionCache::Clear()
+{
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  for (auto& entry : s_cacheEntries) {
+    entry.session.clear();
+  }
+}
+
+void HTTP::TlsSessionCache::RecordHandshake(bool success, bool resumed, uint32_t durationMs)
+{
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  if (!success) {
+    s_metrics.failed++;
+    return;
+  }
+
+  s_metrics.handshakes++;
+  if (resumed) {
+    s_metrics.resumed++;
+  }
+  s_metrics.totalHandshakeMs += durationMs;
+  s_metrics.lastHandshakeMs = durationMs;
+}
+
+HTTP::TlsSessionCache::Metrics HTTP::TlsSessionCache::GetMetrics()
+{
+  OpenShock::ScopedLock lock__(&s_cacheMutex);
+
+  return s_metrics;
+}
@@ -9,6 +9,7 @@ const char* const TAG = "main";
 #include "estop/EStopManager.h"
 #include "events/Events.h"
 #include "GatewayConnectionManager.h"
+#include "http/HTTPRequestManager.h"
 #include "Logging.h"
 #include "OtaUpdateManager.h"
 #include "serial/SerialInputHandler.h"
@@ -119,6 +120,7 @@ void main_app(void* arg)
 {
   while (true) {
     OpenShock::GatewayConnectionManager::Update();
+    OpenShock::HTTP::ReapIdleConnections();
 
     vTaskDelay(5);  // 5 ticks update interval
   }
@@ -46,7 +46,7 @@ void MessageHandlers::WebSocket::HandleGatewayBinary(tcb::span<const uint8_t> da
 
   // Validate buffer
   flatbuffers::Verifier::Options verifierOptions {
-    .max_size = 4096,  // TODO: Profile this
+    .max_size = MessageHandlers::WebSocket::GATEWAY_MAX_MESSAGE_SIZE,
   };
   flatbuffers::Verifier verifier(data.data(), data.size(), verifierOptions);
   if (!verifier.VerifyBuffer<Schemas::GatewayToHubMessage>()) {
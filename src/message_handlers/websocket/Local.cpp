@@ -40,7 +40,7 @@ void MessageHandlers::WebSocket::HandleLocalBinary(uint8_t socketId, tcb::span<c
 
   // Validate buffer
   flatbuffers::Verifier::Options verifierOptions {
-    .max_size = 4096,  // TODO: Profile this
+    .max_size = MessageHandlers::WebSocket::LOCAL_MAX_MESSAGE_SIZE,
   };
   flatbuffers::Verifier verifier(data.data(), data.size(), verifierOptions);
   if (!verifier.VerifyBuffer<Schemas::LocalToHubMessage>()) {
@@ -18,5 +18,8 @@ void _Private::HandlePing(const OpenShock::Serialization::Gateway::GatewayToHubM
     return;
   }
 
-  Serialization::Gateway::SerializePongMessage(GatewayConnectionManager::SendMessageBIN);
+  GatewayLinkQuality linkQuality;
+  bool hasLinkQuality = GatewayConnectionManager::GetLinkQuality(linkQuality);
+
+  Serialization::Gateway::SerializePongMessage(hasLinkQuality ? &linkQuality : nullptr, GatewayConnectionManager::SendMessageBIN);
 }
@@ -4,13 +4,39 @@
 
 #include <esp_system.h>
 
+static bool writeSerial(const char* data, std::size_t len)
+{
+  OS_SERIAL.write(reinterpret_cast<const uint8_t*>(data), len);
+#if ARDUINO_USB_MODE
+  OS_SERIAL_USB.write(reinterpret_cast<const uint8_t*>(data), len);
+#endif
+  return true;
+}
+
 static void handleJsonConfigCommand(std::string_view arg, bool isAutomated)
 {
   if (arg.empty()) {
-    // Get raw config
-    std::string json = OpenShock::Config::GetAsJSON(true);
-
-    SERPR_RESPONSE("JsonConfig|%s", json.c_str());
+    // Checked before the prefix goes out, so this failure is a plain error line
+    auto config = OpenShock::Config::GetSnapshot();
+    if (config == nullptr) {
+      SERPR_ERROR("Failed to get config as JSON");
+      return;
+    }
+
+    // Streamed straight to serial, the JSON is never held in memory as a whole
+    const char prefix[] = "$SYS$|Response|JsonConfig|";
+    writeSerial(prefix, sizeof(prefix) - 1);
+
+    if (!config->WriteJSON(writeSerial, true)) {
+      // Valid JSON ends in '}', so a response line ending in this suffix can never be mistaken for a complete one
+      const char aborted[] = "|Error|Aborted\r\n";
+      writeSerial(aborted, sizeof(aborted) - 1);
+
+      SERPR_ERROR("Failed to get config as JSON");
+      return;
+    }
+
+    writeSerial("\r\n", 2);
     return;
   }
 
@@ -1,7 +1,10 @@
 #include "serial/command_handlers/common.h"
 
+#include "config/Config.h"
 #include "Core.h"
 #include "FormatHelpers.h"
+#include "http/HTTPRequestManager.h"
+#include "http/TlsSessionCache.h"
 #include "wifi/WiFiManager.h"
 #include "wifi/WiFiNetwork.h"
 
@@ -34,6 +37,44 @@ static void handleDebugInfoCommand(std::string_view arg, bool isAutomated)
     OpenShock::WiFiManager::GetIPv6Address(ipAddressBuffer);
     SERPR_RESPONSE("WiFiInfo|IPv6|%s", ipAddressBuffer);
   }
+
+  auto tls = OpenShock::HTTP::TlsSessionCache::GetMetrics();
+  SERPR_RESPONSE("TLSInfo|Handshakes|%u", tls.handshakes);
+  SERPR_RESPONSE("TLSInfo|Resumed|%u", tls.resumed);
+  SERPR_RESPONSE("TLSInfo|Failed|%u", tls.failed);
+  SERPR_RESPONSE("TLSInfo|Resumption Rate|%u%%", tls.handshakes > 0 ? (tls.resumed * 100) / tls.handshakes : 0);
+  SERPR_RESPONSE("TLSInfo|Avg Handshake MS|%llu", tls.handshakes > 0 ? tls.totalHandshakeMs / tls.handshakes : 0);
+  SERPR_RESPONSE("TLSInfo|Last Handshake MS|%u", tls.lastHandshakeMs);
+
+  auto pool = OpenShock::HTTP::GetConnectionPoolMetrics();
+  SERPR_RESPONSE("HTTPInfo|Pool Hits|%u", pool.hits);
+  SERPR_RESPONSE("HTTPInfo|Pool Misses|%u", pool.misses);
+  SERPR_RESPONSE("HTTPInfo|Pool Exhausted|%u", pool.exhausted);
+  SERPR_RESPONSE("HTTPInfo|Pool Hit Rate|%u%%", pool.hits + pool.misses > 0 ? (pool.hits * 100) / (pool.hits + pool.misses) : 0);
+
+  auto downloads = OpenShock::HTTP::GetDownloadMetrics();
+  SERPR_RESPONSE("HTTPInfo|Downloads|%u", downloads.downloads);
+  SERPR_RESPONSE("HTTPInfo|Downloaded Bytes|%llu", downloads.totalBytes);
+  SERPR_RESPONSE("HTTPInfo|Avg Throughput|%llu B/s", downloads.totalMs > 0 ? (downloads.totalBytes * 1000) / downloads.totalMs : 0);
+  SERPR_RESPONSE("HTTPInfo|Last Throughput|%u B/s", downloads.lastBytesPerSecond);
+
+  auto cache = OpenShock::HTTP::GetResponseCacheMetrics();
+  SERPR_RESPONSE("HTTPInfo|Cache Hits|%u", cache.hits);
+  SERPR_RESPONSE("HTTPInfo|Cache Misses|%u", cache.misses);
+
+  auto persist = OpenShock::Config::GetPersistMetrics();
+  SERPR_RESPONSE("ConfigInfo|Writes|%u", persist.writes);
+  SERPR_RESPONSE("ConfigInfo|Writes Avoided|%u", persist.writesAvoided);
+  SERPR_RESPONSE("ConfigInfo|Compactions|%u", persist.compactions);
+  SERPR_RESPONSE("ConfigInfo|Log Bytes|%u", persist.logBytes);
+
+  auto lock = OpenShock::Config::GetLockMetrics();
+  SERPR_RESPONSE("ConfigInfo|Lock Read Waits|%u", lock.readContentions);
+  SERPR_RESPONSE("ConfigInfo|Lock Write Waits|%u", lock.writeContentions);
+  SERPR_RESPONSE("ConfigInfo|Lock Timeouts|%u", lock.timeouts);
+  SERPR_RESPONSE("ConfigInfo|Lock Read Wait|%u us", lock.readWaitUs);
+  SERPR_RESPONSE("ConfigInfo|Lock Write Wait|%u us", lock.writeWaitUs);
+  SERPR_RESPONSE("ConfigInfo|Lock Max Write Wait|%u us", lock.maxWriteWaitUs);
 }
 
 OpenShock::Serial::CommandGroup OpenShock::Serial::CommandHandlers::SysInfoHandler()
@@ -2,6 +2,7 @@
 
 const char* const TAG = "JsonAPI";
 
+#include "Convert.h"
 #include "Logging.h"
 
 #define ESP_LOGJSONE(err, root)                                                    \
@@ -10,6 +11,7 @@ const char* const TAG = "JsonAPI";
     OS_LOGE(TAG, "Invalid JSON response (" err "): %s", _jsonStr ? _jsonStr : ""); \
     cJSON_free(_jsonStr);                                                          \
   }
+#define ESP_LOGSTREAME(err) OS_LOGE(TAG, "Invalid JSON response (" err ")")
 
 using namespace OpenShock::Serialization;
 
@@ -125,95 +127,154 @@ bool JsonAPI::ParseAccountLinkJsonResponse(int code, const cJSON* root, JsonAPI:
 
   return true;
 }
-bool JsonAPI::ParseHubInfoJsonResponse(int code, const cJSON* root, JsonAPI::HubInfoResponse& out)
+bool JsonAPI::HubInfoStreamParser::OnEvent(const JsonStream::Event& event, JsonAPI::HubInfoResponse& out)
 {
-  (void)code;
+  using JsonStream::EventType;
 
-  if (cJSON_IsObject(root) == 0) {
-    ESP_LOGJSONE("not an object", root);
-    return false;
+  if (event.depth == 0) {
+    if (event.type != EventType::ObjectStart && event.type != EventType::ObjectEnd) {
+      ESP_LOGSTREAME("not an object");
+      return false;
+    }
+    return true;
   }
 
-  const cJSON* data = cJSON_GetObjectItemCaseSensitive(root, "data");
-  if (cJSON_IsObject(data) == 0) {
-    ESP_LOGJSONE("value at 'data' is not an object", root);
-    return false;
+  if (event.depth == 1) {
+    if (event.key == "data") {
+      if (event.type != EventType::ObjectStart) {
+        ESP_LOGSTREAME("value at 'data' is not an object");
+        return false;
+      }
+      m_inData = true;
+    } else if (event.type == EventType::ObjectEnd) {
+      m_inData = false;
+    }
+    return true;
   }
 
-  const cJSON* hubId = cJSON_GetObjectItemCaseSensitive(data, "id");
-  if (cJSON_IsString(hubId) == 0) {
-    ESP_LOGJSONE("value at 'data.id' is not a string", root);
-    return false;
+  if (!m_inData) {
+    return true;
   }
 
-  const cJSON* hubName = cJSON_GetObjectItemCaseSensitive(data, "name");
-  if (cJSON_IsString(hubName) == 0) {
-    ESP_LOGJSONE("value at 'data.name' is not a string", root);
-    return false;
+  if (event.depth == 2) {
+    if (event.key == "id") {
+      if (event.type != EventType::String) {
+        ESP_LOGSTREAME("value at 'data.id' is not a string");
+        return false;
+      }
+      out.hubId = event.value;
+    } else if (event.key == "name") {
+      if (event.type != EventType::String) {
+        ESP_LOGSTREAME("value at 'data.name' is not a string");
+        return false;
+      }
+      out.hubName = event.value;
+    } else if (event.key == "shockers") {
+      if (event.type != EventType::ArrayStart) {
+        ESP_LOGSTREAME("value at 'data.shockers' is not an array");
+        return false;
+      }
+      m_inShockers   = true;
+      m_seenShockers = true;
+    } else if (event.type == EventType::ArrayEnd) {
+      m_inShockers = false;
+    }
+    return true;
   }
 
-  const cJSON* hubShockers = cJSON_GetObjectItemCaseSensitive(data, "shockers");
-  if (cJSON_IsArray(hubShockers) == 0) {
-    ESP_LOGJSONE("value at 'data.shockers' is not an array", root);
-    return false;
+  if (!m_inShockers) {
+    return true;
   }
 
-  out = {};
+  if (event.depth == 3) {
+    if (event.type == EventType::ObjectStart) {
+      m_shocker       = {};
+      m_shockerFields = 0;
+      return true;
+    }
 
-  out.hubId   = hubId->valuestring;
-  out.hubName = hubName->valuestring;
+    if (event.type != EventType::ObjectEnd) {
+      ESP_LOGSTREAME("value in 'data.shockers' is not an object");
+      return false;
+    }
 
-  if (out.hubId.empty() || out.hubName.empty()) {
-    ESP_LOGJSONE("value at 'data.id' or 'data.name' is empty", root);
-    return false;
+    if ((m_shockerFields & ShockerFieldAll) != ShockerFieldAll) {
+      ESP_LOGSTREAME("shocker is missing 'id', 'rfId' or 'model'");
+      return false;
+    }
+
+    out.shockers.push_back(std::move(m_shocker));
+    return true;
+  }
+
+  if (event.depth == 4) {
+    return onShockerField(event);
   }
 
-  cJSON* shocker = nullptr;
-  cJSON_ArrayForEach(shocker, hubShockers)
-  {
-    const cJSON* shockerId = cJSON_GetObjectItemCaseSensitive(shocker, "id");
-    if (cJSON_IsString(shockerId) == 0) {
-      ESP_LOGJSONE("value at 'shocker.id' is not a string", shocker);
+  return true;
+}
+
+bool JsonAPI::HubInfoStreamParser::onShockerField(const JsonStream::Event& event)
+{
+  using JsonStream::EventType;
+
+  if (event.key == "id") {
+    if (event.type != EventType::String) {
+      ESP_LOGSTREAME("value at 'shocker.id' is not a string");
       return false;
     }
-    const char* shockerIdStr = shockerId->valuestring;
-
-    if (shockerIdStr == nullptr || shockerIdStr[0] == '\0') {
-      ESP_LOGJSONE("value at 'shocker.id' is empty", shocker);
+    if (event.value.empty()) {
+      ESP_LOGSTREAME("value at 'shocker.id' is empty");
       return false;
     }
 
-    const cJSON* shockerRfId = cJSON_GetObjectItemCaseSensitive(shocker, "rfId");
-    if (cJSON_IsNumber(shockerRfId) == 0) {
-      ESP_LOGJSONE("value at 'shocker.rfId' is not a number", shocker);
+    m_shocker.id = event.value;
+    m_shockerFields |= ShockerFieldId;
+  } else if (event.key == "rfId") {
+    if (event.type != EventType::Number) {
+      ESP_LOGSTREAME("value at 'shocker.rfId' is not a number");
       return false;
     }
-    int shockerRfIdInt = shockerRfId->valueint;
-    if (shockerRfIdInt < 0 || shockerRfIdInt > UINT16_MAX) {
-      ESP_LOGJSONE("value at 'shocker.rfId' is not a valid uint16_t", shocker);
+    if (!OpenShock::Convert::ToUint16(event.value, m_shocker.rfId)) {
+      ESP_LOGSTREAME("value at 'shocker.rfId' is not a valid uint16_t");
       return false;
     }
-    uint16_t shockerRfIdU16 = static_cast<uint16_t>(shockerRfIdInt);
 
-    const cJSON* shockerModel = cJSON_GetObjectItemCaseSensitive(shocker, "model");
-    if (cJSON_IsString(shockerModel) == 0) {
-      ESP_LOGJSONE("value at 'shocker.model' is not a string", shocker);
+    m_shockerFields |= ShockerFieldRfId;
+  } else if (event.key == "model") {
+    if (event.type != EventType::String) {
+      ESP_LOGSTREAME("value at 'shocker.model' is not a string");
       return false;
     }
-    const char* shockerModelStr = shockerModel->valuestring;
-
-    if (shockerModelStr == nullptr || shockerModelStr[0] == '\0') {
-      ESP_LOGJSONE("value at 'shocker.model' is empty", shocker);
+    if (event.value.empty()) {
+      ESP_LOGSTREAME("value at 'shocker.model' is empty");
       return false;
     }
 
-    OpenShock::ShockerModelType shockerModelType;
-    if (!OpenShock::ShockerModelTypeFromString(shockerModelStr, shockerModelType, true)) {  // PetTrainer is a typo in the API, we pass true to allow it
-      ESP_LOGJSONE("value at 'shocker.model' is not a valid shocker model", shocker);
+    std::string model(event.value);
+    if (!OpenShock::ShockerModelTypeFromString(model.c_str(), m_shocker.model, true)) {  // PetTrainer is a typo in the API, we pass true to allow it
+      ESP_LOGSTREAME("value at 'shocker.model' is not a valid shocker model");
       return false;
     }
 
-    out.shockers.push_back({.id = shockerIdStr, .rfId = shockerRfIdU16, .model = shockerModelType});
+    m_shockerFields |= ShockerFieldModel;
+  }
+
+  return true;
+}
+
+bool JsonAPI::HubInfoStreamParser::OnComplete(int code, JsonAPI::HubInfoResponse& out)
+{
+  (void)code;
+
+  if (!m_seenShockers) {
+    ESP_LOGSTREAME("value at 'data.shockers' is missing");
+    return false;
+  }
+
+  if (out.hubId.empty() || out.hubName.empty()) {
+    ESP_LOGSTREAME("value at 'data.id' or 'data.name' is empty");
+    return false;
   }
 
   return true;
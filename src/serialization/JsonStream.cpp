@@ -0,0 +1,372 @@
+#include "serialization/JsonStream.h"
+
+const char* const TAG = "JsonStream";
+
+#include "Logging.h"
+
+using namespace OpenShock::Serialization::JsonStream;
+
+static bool isWhitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Validates the JSON number grammar: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool isValidNumber(std::string_view str)
+{
+  std::size_t i = 0, n = str.size();
+
+  if (i < n && str[i] == '-') i++;
+  if (i >= n) return false;
+
+  if (str[i] == '0') {
+    i++;
+  } else if (isDigit(str[i])) {
+    while (i < n && isDigit(str[i])) i++;
+  } else {
+    return false;
+  }
+
+  if (i < n && str[i] == '.') {
+    i++;
+    if (i >= n || !isDigit(str[i])) return false;
+    while (i < n && isDigit(str[i])) i++;
+  }
+
+  if (i < n && (str[i] == 'e' || str[i] == 'E')) {
+    i++;
+    if (i < n && (str[i] == '+' || str[i] == '-')) i++;
+    if (i >= n || !isDigit(str[i])) return false;
+    while (i < n && isDigit(str[i])) i++;
+  }
+
+  return i == n;
+}
+
+Reader::Reader(EventHandler handler)
+  : m_handler(std::move(handler))
+  , m_state(State::ExpectValue)
+  , m_readingKey(false)
+  , m_depth(0)
+  , m_unicodeDigits(0)
+  , m_unicodeValue(0)
+  , m_highSurrogate(0)
+  , m_containers()
+  , m_key()
+  , m_token()
+{
+}
+
+bool Reader::Feed(const uint8_t* data, std::size_t len)
+{
+  for (std::size_t i = 0; i < len; ++i) {
+    if (!processByte(static_cast<char>(data[i]))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Reader::Finish()
+{
+  switch (m_state) {
+    case State::InNumber:
+      if (!finishNumber()) return false;
+      break;
+    case State::InLiteral:
+      if (!finishLiteral()) return false;
+      break;
+    case State::Failed:
+      return false;
+    default:
+      break;
+  }
+
+  if (m_state != State::Done) {
+    return fail("unexpected end of document");
+  }
+
+  return true;
+}
+
+bool Reader::processByte(char c)
+{
+  switch (m_state) {
+    case State::ExpectValue:
+      if (isWhitespace(c)) return true;
+      return beginValue(c);
+    case State::ExpectValueOrEnd:
+      if (isWhitespace(c)) return true;
+      if (c == ']') return closeContainer(c);
+      return beginValue(c);
+    case State::ExpectKeyOrEnd:
+      if (isWhitespace(c)) return true;
+      if (c == '}') return closeContainer(c);
+      [[fallthrough]];
+    case State::ExpectKey:
+      if (isWhitespace(c)) return true;
+      if (c != '"') return fail("expected a key");
+      m_readingKey = true;
+      m_token.clear();
+      m_state = State::InString;
+      return true;
+    case State::ExpectColon:
+      if (isWhitespace(c)) return true;
+      if (c != ':') return fail("expected ':'");
+      m_state = State::ExpectValue;
+      return true;
+    case State::ExpectCommaOrEnd:
+      if (isWhitespace(c)) return true;
+      if (c == ',') {
+        m_state = m_containers[m_depth - 1] == '{' ? State::ExpectKey : State::ExpectValue;
+        return true;
+      }
+      if (c == '}' || c == ']') return closeContainer(c);
+      return fail("expected ',' or end of container");
+    case State::InString:
+      if (m_highSurrogate != 0 && c != '\\') return fail("unpaired surrogate");
+      if (c == '"') return finishString();
+      if (c == '\\') {
+        m_state = State::InStringEscape;
+        return true;
+      }
+      if (static_cast<uint8_t>(c) < 0x20) return fail("control character in string");
+      return appendToken(c);
+    case State::InStringEscape:
+      if (m_highSurrogate != 0 && c != 'u') return fail("unpaired surrogate");
+      m_state = State::InString;
+      switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+          return appendToken(c);
+        case 'b':
+          return appendToken('\b');
+        case 'f':
+          return appendToken('\f');
+        case 'n':
+          return appendToken('\n');
+        case 'r':
+          return appendToken('\r');
+        case 't':
+          return appendToken('\t');
+        case 'u':
+          m_unicodeDigits = 0;
+          m_unicodeValue  = 0;
+          m_state         = State::InStringUnicode;
+          return true;
+        default:
+          return fail("invalid escape sequence");
+      }
+    case State::InStringUnicode: {
+      int digit = hexValue(c);
+      if (digit < 0) return fail("invalid unicode escape");
+
+      m_unicodeValue = static_cast<uint16_t>((m_unicodeValue << 4) | digit);
+      if (++m_unicodeDigits < 4) return true;
+
+      m_state = State::InString;
+
+      if (m_unicodeValue >= 0xD800 && m_unicodeValue <= 0xDBFF) {
+        if (m_highSurrogate != 0) return fail("unpaired surrogate");
+        m_highSurrogate = m_unicodeValue;
+        return true;
+      }
+
+      if (m_unicodeValue >= 0xDC00 && m_unicodeValue <= 0xDFFF) {
+        if (m_highSurrogate == 0) return fail("unpaired surrogate");
+        uint32_t codepoint = 0x10000 + ((static_cast<uint32_t>(m_highSurrogate) - 0xD800) << 10) + (m_unicodeValue - 0xDC00);
+        m_highSurrogate    = 0;
+        return appendCodepoint(codepoint);
+      }
+
+      if (m_highSurrogate != 0) return fail("unpaired surrogate");
+
+      return appendCodepoint(m_unicodeValue);
+    }
+    case State::InNumber:
+      if (isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') return appendToken(c);
+      if (!finishNumber()) return false;
+      return processByte(c);  // The terminating character belongs to the enclosing structure
+    case State::InLiteral:
+      if (c >= 'a' && c <= 'z') return appendToken(c);
+      if (!finishLiteral()) return false;
+      return processByte(c);
+    case State::Done:
+      if (isWhitespace(c)) return true;
+      return fail("trailing data after document");
+    case State::Failed:
+    default:
+      return false;
+  }
+}
+
+bool Reader::beginValue(char c)
+{
+  if (c == '{' || c == '[') {
+    if (m_depth >= MAX_DEPTH) {
+      return fail("document nested too deeply");
+    }
+
+    if (!emit(c == '{' ? EventType::ObjectStart : EventType::ArrayStart, {})) {
+      return false;
+    }
+
+    m_containers[m_depth++] = c;
+    m_key.clear();
+    m_state = c == '{' ? State::ExpectKeyOrEnd : State::ExpectValueOrEnd;
+    return true;
+  }
+
+  if (c == '"') {
+    m_readingKey = false;
+    m_token.clear();
+    m_state = State::InString;
+    return true;
+  }
+
+  if (c == '-' || isDigit(c)) {
+    m_token.clear();
+    m_state = State::InNumber;
+    return appendToken(c);
+  }
+
+  if (c == 't' || c == 'f' || c == 'n') {
+    m_token.clear();
+    m_state = State::InLiteral;
+    return appendToken(c);
+  }
+
+  return fail("expected a value");
+}
+
+bool Reader::endValue()
+{
+  m_key.clear();
+  m_state = m_depth == 0 ? State::Done : State::ExpectCommaOrEnd;
+  return true;
+}
+
+bool Reader::closeContainer(char c)
+{
+  char open = m_containers[m_depth - 1];
+  if ((c == '}' && open != '{') || (c == ']' && open != '[')) {
+    return fail("mismatched brackets");
+  }
+
+  m_depth--;
+  m_key.clear();
+
+  if (!emit(c == '}' ? EventType::ObjectEnd : EventType::ArrayEnd, {})) {
+    return false;
+  }
+
+  return endValue();
+}
+
+bool Reader::finishString()
+{
+  if (m_readingKey) {
+    m_readingKey = false;
+    m_key.assign(m_token);
+    m_state = State::ExpectColon;
+    return true;
+  }
+
+  if (!emit(EventType::String, m_token)) {
+    return false;
+  }
+
+  return endValue();
+}
+
+bool Reader::finishNumber()
+{
+  if (!isValidNumber(m_token)) {
+    return fail("invalid number");
+  }
+
+  if (!emit(EventType::Number, m_token)) {
+    return false;
+  }
+
+  return endValue();
+}
+
+bool Reader::finishLiteral()
+{
+  EventType type;
+  if (m_token == "true" || m_token == "false") {
+    type = EventType::Bool;
+  } else if (m_token == "null") {
+    type = EventType::Null;
+  } else {
+    return fail("invalid literal");
+  }
+
+  if (!emit(type, m_token)) {
+    return false;
+  }
+
+  return endValue();
+}
+
+bool Reader::appendToken(char c)
+{
+  if (m_token.size() >= MAX_TOKEN_LENGTH) {
+    return fail("token too long");
+  }
+
+  m_token.push_back(c);
+
+  return true;
+}
+
+bool Reader::appendCodepoint(uint32_t codepoint)
+{
+  if (codepoint < 0x80) {
+    return appendToken(static_cast<char>(codepoint));
+  }
+  if (codepoint < 0x800) {
+    return appendToken(static_cast<char>(0xC0 | (codepoint >> 6))) && appendToken(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+  if (codepoint < 0x10000) {
+    return appendToken(static_cast<char>(0xE0 | (codepoint >> 12))) && appendToken(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F))) && appendToken(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+
+  return appendToken(static_cast<char>(0xF0 | (codepoint >> 18))) && appendToken(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F))) && appendToken(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)))
+      && appendToken(static_cast<char>(0x80 | (codepoint & 0x3F)));
+}
+
+bool Reader::emit(EventType type, std::string_view value)
+{
+  Event event {.type = type, .depth = m_depth, .key = m_key, .value = value};
+
+  if (!m_handler(event)) {
+    m_state = State::Failed;  // The handler is responsible for logging why it rejected the document
+    return false;
+  }
+
+  return true;
+}
+
+bool Reader::fail(const char* reason)
+{
+  OS_LOGW(TAG, "Invalid JSON: %s", reason);
+  m_state = State::Failed;
+  return false;
+}
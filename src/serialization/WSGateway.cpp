@@ -26,7 +26,7 @@ const char* const TAG = "WSGateway";
 
 using namespace OpenShock::Serialization;
 
-bool Gateway::SerializePongMessage(Common::SerializationCallbackFn callback)
+bool Gateway::SerializePongMessage(const OpenShock::GatewayLinkQuality* linkQuality, Common::SerializationCallbackFn callback)
 {
   int64_t uptime = OpenShock::millis();
   if (uptime < 0) {
@@ -41,9 +41,16 @@ bool Gateway::SerializePongMessage(Common::SerializationCallbackFn callback)
     return false;
   }
 
-  flatbuffers::FlatBufferBuilder builder(64);
+  flatbuffers::FlatBufferBuilder builder(128);
 
-  auto pong = Gateway::CreatePong(builder, static_cast<uint64_t>(uptime), static_cast<int32_t>(rssi));
+  flatbuffers::Offset<Gateway::Pong> pong;
+  if (linkQuality != nullptr) {
+    auto rttHistogram = builder.CreateVector(linkQuality->rttHistogram.data(), linkQuality->rttHistogram.size());
+
+    pong = Gateway::CreatePong(builder, static_cast<uint64_t>(uptime), static_cast<int32_t>(rssi), linkQuality->rttEwmaUs, linkQuality->rttJitterUs, rttHistogram, linkQuality->probesSent, linkQuality->probesLost);
+  } else {
+    pong = Gateway::CreatePong(builder, static_cast<uint64_t>(uptime), static_cast<int32_t>(rssi));
+  }
 
   auto msg = Gateway::CreateHubToGatewayMessage(builder, Gateway::HubToGatewayMessagePayload::Pong, pong.Union());
 
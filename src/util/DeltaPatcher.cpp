@@ -0,0 +1,276 @@
+#include "util/DeltaPatcher.h"
+
+const char* const TAG = "DeltaPatcher";
+
+#include "Hashing.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+const uint8_t DELTA_PATCH_MAGIC[4]  = {'O', 'S', 'D', 'P'};
+const uint8_t DELTA_PATCH_VERSION   = 1;
+const uint8_t DELTA_PATCH_OP_END    = 0;
+const uint8_t DELTA_PATCH_OP_COPY   = 1;
+const uint8_t DELTA_PATCH_OP_ADD    = 2;
+const uint8_t DELTA_PATCH_OP_INSERT = 3;
+
+using namespace OpenShock;
+
+static uint32_t readU32(const uint8_t* data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+DeltaPatcher::DeltaPatcher(const esp_partition_t* source)
+  : m_source(source)
+  , m_buffer(nullptr)
+  , m_field()
+  , m_fieldPos(0)
+  , m_state(State::Header)
+  , m_sourceSize(0)
+  , m_targetSize(0)
+  , m_opOffset(0)
+  , m_opRemaining(0)
+  , m_outputSize(0)
+{
+  m_buffer = static_cast<uint8_t*>(malloc(BUFFER_SIZE));
+  if (m_buffer == nullptr) {
+    OS_LOGE(TAG, "Out of memory");
+  }
+}
+
+DeltaPatcher::~DeltaPatcher()
+{
+  free(m_buffer);
+}
+
+void DeltaPatcher::reset()
+{
+  m_fieldPos    = 0;
+  m_state       = State::Header;
+  m_sourceSize  = 0;
+  m_targetSize  = 0;
+  m_opOffset    = 0;
+  m_opRemaining = 0;
+  m_outputSize  = 0;
+}
+
+bool DeltaPatcher::feed(const uint8_t* data, std::size_t len, const OutputCallback& output)
+{
+  if (!ok() || m_state == State::Failed) {
+    return false;
+  }
+
+  while (len > 0) {
+    switch (m_state) {
+      case State::Header:
+        m_field[m_fieldPos++] = *data++;
+        len--;
+
+        if (m_fieldPos == HEADER_SIZE && !parseHeader()) {
+          return false;
+        }
+        break;
+      case State::Op:
+        m_field[m_fieldPos++] = *data++;
+        len--;
+
+        if (m_field[0] == DELTA_PATCH_OP_END) {
+          if (m_outputSize != m_targetSize) {
+            return fail("patch ended before the target size was reached");
+          }
+          m_state = State::Done;
+          break;
+        }
+
+        if (m_fieldPos == OP_HEADER_SIZE && !beginOp(output)) {
+          return false;
+        }
+        break;
+      case State::Add: {
+        std::size_t n = std::min<std::size_t>({len, m_opRemaining, BUFFER_SIZE});
+        if (!readSource(m_opOffset, n)) {
+          return false;
+        }
+
+        for (std::size_t i = 0; i < n; ++i) {
+          m_buffer[i] += data[i];
+        }
+
+        if (!output(m_buffer, n)) {
+          m_state = State::Failed;
+          return false;
+        }
+
+        data += n;
+        len -= n;
+        m_opOffset += n;
+        m_opRemaining -= n;
+        m_outputSize += n;
+
+        if (m_opRemaining == 0) {
+          m_state = State::Op;
+        }
+        break;
+      }
+      case State::Insert: {
+        // Literal bytes are passed through without copying
+        std::size_t n = std::min<std::size_t>(len, m_opRemaining);
+        if (!output(data, n)) {
+          m_state = State::Failed;
+          return false;
+        }
+
+        data += n;
+        len -= n;
+        m_opRemaining -= n;
+        m_outputSize += n;
+
+        if (m_opRemaining == 0) {
+          m_state = State::Op;
+        }
+        break;
+      }
+      case State::Done:
+        return fail("trailing data after patch");
+      case State::Failed:
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool DeltaPatcher::parseHeader()
+{
+  if (memcmp(m_field, DELTA_PATCH_MAGIC, sizeof(DELTA_PATCH_MAGIC)) != 0) {
+    return fail("not a delta patch");
+  }
+
+  if (m_field[4] != DELTA_PATCH_VERSION) {
+    return fail("unsupported patch version");
+  }
+
+  m_sourceSize = readU32(m_field + 5);
+  m_targetSize = readU32(m_field + 9);
+
+  if (m_sourceSize > m_source->size) {
+    return fail("source image is larger than the source partition");
+  }
+
+  if (!verifySource()) {
+    return false;
+  }
+
+  OS_LOGI(TAG, "Applying patch from %u to %u bytes", m_sourceSize, m_targetSize);
+
+  m_fieldPos = 0;
+  m_state    = State::Op;
+
+  return true;
+}
+
+bool DeltaPatcher::beginOp(const OutputCallback& output)
+{
+  uint8_t op    = m_field[0];
+  m_opOffset    = readU32(m_field + 1);
+  m_opRemaining = readU32(m_field + 5);
+  m_fieldPos    = 0;
+
+  if (m_opRemaining > m_targetSize - m_outputSize) {
+    return fail("patch writes past the target size");
+  }
+
+  if (op == DELTA_PATCH_OP_INSERT) {
+    m_state = m_opRemaining > 0 ? State::Insert : State::Op;
+    return true;
+  }
+
+  if (op != DELTA_PATCH_OP_COPY && op != DELTA_PATCH_OP_ADD) {
+    return fail("unknown op");
+  }
+
+  if (m_opRemaining > m_sourceSize || m_opOffset > m_sourceSize - m_opRemaining) {
+    return fail("patch reads past the source image");
+  }
+
+  if (op == DELTA_PATCH_OP_ADD) {
+    m_state = m_opRemaining > 0 ? State::Add : State::Op;
+    return true;
+  }
+
+  // COPY needs no patch data, emit it right away
+  while (m_opRemaining > 0) {
+    std::size_t n = std::min<std::size_t>(m_opRemaining, BUFFER_SIZE);
+    if (!readSource(m_opOffset, n)) {
+      return false;
+    }
+
+    if (!output(m_buffer, n)) {
+      m_state = State::Failed;
+      return false;
+    }
+
+    m_opOffset += n;
+    m_opRemaining -= n;
+    m_outputSize += n;
+  }
+
+  m_state = State::Op;
+
+  return true;
+}
+
+bool DeltaPatcher::verifySource()
+{
+  // The patch is only meaningful against the exact image it was made from
+  OpenShock::SHA256 sha256;
+  if (!sha256.begin()) {
+    return fail("failed to initialize SHA256 hash");
+  }
+
+  for (std::size_t offset = 0; offset < m_sourceSize; offset += BUFFER_SIZE) {
+    std::size_t n = std::min<std::size_t>(BUFFER_SIZE, m_sourceSize - offset);
+    if (!readSource(offset, n)) {
+      return false;
+    }
+
+    if (!sha256.update(m_buffer, n)) {
+      return fail("failed to update SHA256 hash");
+    }
+  }
+
+  std::array<uint8_t, 32> hash;
+  if (!sha256.finish(hash)) {
+    return fail("failed to finish SHA256 hash");
+  }
+
+  if (memcmp(hash.data(), m_field + 13, hash.size()) != 0) {
+    return fail("source image does not match the patch");
+  }
+
+  return true;
+}
+
+bool DeltaPatcher::readSource(std::size_t offset, std::size_t len)
+{
+  esp_err_t err = esp_partition_read(m_source, offset, m_buffer, len);
+  if (err != ESP_OK) {
+    OS_LOGE(TAG, "Failed to read source partition at %zu: %s", offset, esp_err_to_name(err));
+    m_state = State::Failed;
+    return false;
+  }
+
+  return true;
+}
+
+bool DeltaPatcher::fail(const char* reason)
+{
+  OS_LOGE(TAG, "Failed to apply delta patch: %s", reason);
+  m_state = State::Failed;
+  return false;
+}
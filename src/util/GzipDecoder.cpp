@@ -0,0 +1,210 @@
+#include "util/GzipDecoder.h"
+
+const char* const TAG = "GzipDecoder";
+
+#include "Logging.h"
+
+#include <rom/miniz.h>
+
+#include <cstdlib>
+
+const uint8_t GZIP_FLAG_HCRC    = 1 << 1;
+const uint8_t GZIP_FLAG_EXTRA   = 1 << 2;
+const uint8_t GZIP_FLAG_NAME    = 1 << 3;
+const uint8_t GZIP_FLAG_COMMENT = 1 << 4;
+
+using namespace OpenShock;
+
+static_assert((TINFL_LZ_DICT_SIZE & (TINFL_LZ_DICT_SIZE - 1)) == 0, "Inflate window must be a power of two");
+
+GzipDecoder::GzipDecoder()
+  : m_inflator(nullptr)
+  , m_window(nullptr)
+  , m_windowOffset(0)
+  , m_outputSize(0)
+  , m_state(State::Header)
+  , m_flags(0)
+  , m_fieldPos(0)
+  , m_fieldLength(0)
+  , m_trailer()
+{
+  m_inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
+  m_window   = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
+  if (!ok()) {
+    OS_LOGE(TAG, "Out of memory");
+    return;
+  }
+
+  reset();
+}
+
+GzipDecoder::~GzipDecoder()
+{
+  free(m_inflator);
+  free(m_window);
+}
+
+void GzipDecoder::reset()
+{
+  if (m_inflator != nullptr) {
+    tinfl_init(m_inflator);
+  }
+
+  m_windowOffset = 0;
+  m_outputSize   = 0;
+  m_state        = State::Header;
+  m_flags        = 0;
+  m_fieldPos     = 0;
+  m_fieldLength  = 0;
+}
+
+bool GzipDecoder::feed(const uint8_t* data, std::size_t len, const OutputCallback& output)
+{
+  if (!ok() || m_state == State::Failed) {
+    return false;
+  }
+
+  while (len > 0) {
+    switch (m_state) {
+      case State::Deflate:
+        if (!inflate(data, len, output)) {
+          return false;
+        }
+        break;
+      case State::Trailer:
+        m_trailer[m_fieldPos++] = *data++;
+        len--;
+
+        if (m_fieldPos == sizeof(m_trailer)) {
+          // CRC-32 is not checked, the caller hashes the decoded image; ISIZE catches truncation
+          uint32_t size = m_trailer[4] | (m_trailer[5] << 8) | (m_trailer[6] << 16) | (static_cast<uint32_t>(m_trailer[7]) << 24);
+          if (size != static_cast<uint32_t>(m_outputSize)) {
+            return fail("decoded size does not match trailer");
+          }
+          m_state = State::Done;
+        }
+        break;
+      case State::Done:
+        return fail("trailing data after stream");
+      case State::Failed:
+        return false;
+      default:
+        if (!parseHeaderByte(*data++)) {
+          return false;
+        }
+        len--;
+        break;
+    }
+  }
+
+  return true;
+}
+
+bool GzipDecoder::parseHeaderByte(uint8_t c)
+{
+  switch (m_state) {
+    case State::Header:
+      // ID1 ID2 CM FLG MTIME(4) XFL OS
+      if ((m_fieldPos == 0 && c != 0x1F) || (m_fieldPos == 1 && c != 0x8B)) {
+        return fail("not a gzip stream");
+      }
+      if (m_fieldPos == 2 && c != 8) {
+        return fail("unsupported compression method");
+      }
+      if (m_fieldPos == 3) {
+        m_flags = c;
+      }
+
+      if (++m_fieldPos < 10) {
+        return true;
+      }
+
+      m_fieldPos = 0;
+      m_state    = State::ExtraLength;
+      break;
+    case State::ExtraLength:
+      m_fieldLength |= static_cast<uint16_t>(c) << (8 * m_fieldPos);
+      if (++m_fieldPos < 2) {
+        return true;
+      }
+      m_fieldPos = 0;
+      m_state    = m_fieldLength > 0 ? State::Extra : State::Name;
+      break;
+    case State::Extra:
+      if (--m_fieldLength > 0) {
+        return true;
+      }
+      m_state = State::Name;
+      break;
+    case State::Name:
+    case State::Comment:
+      if (c != '\0') {
+        return true;
+      }
+      m_state = m_state == State::Name ? State::Comment : State::HeaderCrc;
+      break;
+    case State::HeaderCrc:
+      if (++m_fieldPos < 2) {
+        return true;
+      }
+      m_fieldPos = 0;
+      m_state    = State::Deflate;
+      return true;
+    default:
+      return fail("unexpected header state");
+  }
+
+  // Skip the optional header fields that are not present
+  if (m_state == State::ExtraLength && (m_flags & GZIP_FLAG_EXTRA) == 0) m_state = State::Name;
+  if (m_state == State::Extra && (m_flags & GZIP_FLAG_EXTRA) == 0) m_state = State::Name;
+  if (m_state == State::Name && (m_flags & GZIP_FLAG_NAME) == 0) m_state = State::Comment;
+  if (m_state == State::Comment && (m_flags & GZIP_FLAG_COMMENT) == 0) m_state = State::HeaderCrc;
+  if (m_state == State::HeaderCrc && (m_flags & GZIP_FLAG_HCRC) == 0) m_state = State::Deflate;
+
+  return true;
+}
+
+bool GzipDecoder::inflate(const uint8_t*& data, std::size_t& len, const OutputCallback& output)
+{
+  while (true) {
+    std::size_t inBytes  = len;
+    std::size_t outBytes = TINFL_LZ_DICT_SIZE - m_windowOffset;
+
+    tinfl_status status = tinfl_decompress(m_inflator, data, &inBytes, m_window, m_window + m_windowOffset, &outBytes, TINFL_FLAG_HAS_MORE_INPUT);
+
+    data += inBytes;
+    len -= inBytes;
+
+    if (outBytes > 0) {
+      if (!output(m_window + m_windowOffset, outBytes)) {
+        m_state = State::Failed;
+        return false;
+      }
+
+      m_outputSize += outBytes;
+      m_windowOffset = (m_windowOffset + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    }
+
+    if (status == TINFL_STATUS_DONE) {
+      m_fieldPos = 0;
+      m_state    = State::Trailer;
+      return true;
+    }
+
+    if (status < TINFL_STATUS_DONE) {
+      return fail("corrupt deflate stream");
+    }
+
+    // Keep draining while the window is full, otherwise wait for more input
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && len == 0) {
+      return true;
+    }
+  }
+}
+
+bool GzipDecoder::fail(const char* reason)
+{
+  OS_LOGE(TAG, "Failed to decode gzip stream: %s", reason);
+  m_state = State::Failed;
+  return false;
+}
@@ -2,11 +2,35 @@
 
 const char* const TAG = "PartitionUtils";
 
+#include "config/Config.h"
+#include "Convert.h"
 #include "Core.h"
 #include "Hashing.h"
 #include "http/HTTPRequestManager.h"
 #include "Logging.h"
+#include "util/DeltaPatcher.h"
+#include "util/GzipDecoder.h"
 #include "util/HexUtils.h"
+#include "util/PartitionWriter.h"
+#include "util/StringUtils.h"
+
+#include <esp_spi_flash.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+const std::size_t OTA_RESUME_PERSIST_INTERVAL = 64 * 1024;  // Bytes downloaded between resume checkpoints
+const int OTA_DOWNLOAD_ATTEMPTS               = 5;
+const uint32_t OTA_DOWNLOAD_RETRY_DELAY       = 5000;  // 5 seconds
+const std::size_t OTA_BLOCK_MERGE_GAP         = 4;     // Unchanged blocks fetched anyway to join two ranges into one request
+const std::size_t OTA_BLOCK_MAX_RANGES        = 6;     // Keeps a block update well within the per-domain request rate limit
+
+struct ChangedBlock {
+  uint32_t index;
+  uint8_t hash[32];
+};
 
 bool OpenShock::TryGetPartitionHash(const esp_partition_t* partition, char (&hash)[65])
 {
@@ -23,7 +47,56 @@ bool OpenShock::TryGetPartitionHash(const esp_partition_t* partition, char (&has
   return true;
 }
 
-bool OpenShock::FlashPartitionFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback)
+static std::size_t alignDownToSector(std::size_t offset)
+{
+  return offset - (offset % SPI_FLASH_SEC_SIZE);
+}
+
+// Hashes what a previous attempt already wrote, so the running SHA-256 never has to be persisted
+static bool tryHashPartitionPrefix(const esp_partition_t* partition, std::size_t length, OpenShock::SHA256& sha256)
+{
+  uint8_t* buffer = static_cast<uint8_t*>(malloc(SPI_FLASH_SEC_SIZE));
+  if (buffer == nullptr) {
+    OS_LOGE(TAG, "Out of memory");
+    return false;
+  }
+
+  bool success = true;
+  for (std::size_t offset = 0; offset < length; offset += SPI_FLASH_SEC_SIZE) {
+    std::size_t chunkLen = std::min<std::size_t>(SPI_FLASH_SEC_SIZE, length - offset);
+
+    if (esp_partition_read(partition, offset, buffer, chunkLen) != ESP_OK || !sha256.update(buffer, chunkLen)) {
+      OS_LOGE(TAG, "Failed to hash already written data");
+      success = false;
+      break;
+    }
+  }
+
+  free(buffer);
+
+  return success;
+}
+
+static std::size_t getResumeOffset(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32])
+{
+  std::string label, url;
+  uint8_t hash[32];
+  uint32_t offset;
+  if (!OpenShock::Config::GetOtaResumeState(label, url, hash, offset)) {
+    return 0;
+  }
+
+  if (label != partition->label || url != remoteUrl || memcmp(hash, remoteHash, 32) != 0 || offset > partition->size) {
+    OS_LOGD(TAG, "Discarding OTA resume state for a different download");
+    OpenShock::Config::ClearOtaResumeState();
+    return 0;
+  }
+
+  // Writes continue past the last persisted offset, so the sector it falls into may be partially written
+  return alignDownToSector(offset);
+}
+
+bool OpenShock::FlashPartitionFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback, PartitionCompression compression, const esp_partition_t* patchSource)
 {
   OpenShock::SHA256 sha256;
   if (!sha256.begin()) {
@@ -31,69 +104,234 @@ bool OpenShock::FlashPartitionFromUrl(const esp_partition_t* partition, std::str
     return false;
   }
 
-  std::size_t contentLength  = 0;
-  std::size_t contentWritten = 0;
+  // Compressed downloads and patches can only resume within this run, their state cannot be rebuilt from flash after a reboot
+  std::unique_ptr<OpenShock::GzipDecoder> decoder;
+  if (compression == PartitionCompression::Gzip) {
+    decoder = std::make_unique<OpenShock::GzipDecoder>();
+    if (!decoder->ok()) {
+      OS_LOGE(TAG, "Failed to initialize decompressor");
+      return false;
+    }
+  }
+
+  std::unique_ptr<OpenShock::DeltaPatcher> patcher;
+  if (patchSource != nullptr) {
+    patcher = std::make_unique<OpenShock::DeltaPatcher>(patchSource);
+    if (!patcher->ok()) {
+      OS_LOGE(TAG, "Failed to initialize delta patcher");
+      return false;
+    }
+  }
+
+  bool resumable = decoder == nullptr && patcher == nullptr;
+
+  std::size_t resumeOffset = 0;
+  if (resumable) {
+    resumeOffset = getResumeOffset(partition, remoteUrl, remoteHash);
+  } else {
+    OpenShock::Config::ClearOtaResumeState();
+  }
+
+  if (resumeOffset > 0) {
+    OS_LOGI(TAG, "Resuming partition download at %zu bytes", resumeOffset);
+
+    if (!tryHashPartitionPrefix(partition, resumeOffset, sha256)) {
+      resumeOffset = 0;
+      if (!sha256.begin()) {
+        OS_LOGE(TAG, "Failed to initialize SHA256 hash");
+        return false;
+      }
+    }
+  }
+
+  // Flash writes and hashing happen on the writer task while this task keeps receiving
+  OpenShock::PartitionWriter writer(partition, sha256, resumeOffset);
+  if (!writer.ok()) {
+    OS_LOGE(TAG, "Failed to start partition writer");
+    return false;
+  }
+
+  std::size_t contentLength  = 0;             // Bytes the server sends, compressed or a patch when decoding
+  std::size_t downloaded     = resumeOffset;  // Bytes received so far, where a Range request resumes
+  std::size_t contentWritten = resumeOffset;  // Image bytes handed to the writer
+  std::size_t persistedAt    = resumeOffset;
   int64_t lastProgress       = 0;
 
-  auto sizeValidator = [partition, &contentLength, progressCallback, &lastProgress](std::size_t size) -> bool {
+  auto sizeValidator = [partition, &writer, resumable, &contentLength, &downloaded, progressCallback, &lastProgress](std::size_t size) -> bool {
     if (size > partition->size) {
       OS_LOGE(TAG, "Remote partition binary is too large");
       return false;
     }
 
-    // Erase app partition.
-    if (esp_partition_erase_range(partition, 0, partition->size) != ESP_OK) {
-      OS_LOGE(TAG, "Failed to erase partition in preparation for update");
+    if (contentLength != 0 && size != contentLength) {
+      OS_LOGE(TAG, "Remote partition binary changed size between attempts");
       return false;
     }
 
+    // The writer erases just ahead of itself, this keeps it from touching sectors past the image
+    if (resumable) {
+      writer.setImageSize(size);
+    }
+
     contentLength = size;
 
     lastProgress = OpenShock::millis();
-    progressCallback(0, contentLength, 0.0f);
+    progressCallback(downloaded, contentLength, static_cast<float>(downloaded) / static_cast<float>(contentLength));
 
     return true;
   };
-  auto dataWriter = [partition, &sha256, &contentLength, &contentWritten, progressCallback, &lastProgress](std::size_t offset, const uint8_t* data, std::size_t length) -> bool {
-    if (esp_partition_write(partition, offset, data, length) != ESP_OK) {
-      OS_LOGE(TAG, "Failed to write to partition");
+  auto imageWriter = [partition, &writer, &contentWritten](const uint8_t* data, std::size_t length) -> bool {
+    if (contentWritten + length > partition->size) {
+      OS_LOGE(TAG, "Decompressed partition binary is too large");
       return false;
     }
 
-    if (!sha256.update(data, length)) {
-      OS_LOGE(TAG, "Failed to update SHA256 hash");
+    if (!writer.write(contentWritten, data, length)) {
+      OS_LOGE(TAG, "Failed to write to partition");
       return false;
     }
 
     contentWritten += length;
 
+    return true;
+  };
+  std::function<bool(const uint8_t*, std::size_t)> payloadWriter = imageWriter;
+  if (patcher != nullptr) {
+    payloadWriter = [&patcher, &imageWriter](const uint8_t* data, std::size_t length) -> bool { return patcher->feed(data, length, imageWriter); };
+  }
+  auto dataWriter = [partition, remoteUrl, &remoteHash, &sha256, &writer, resumable, &decoder, &patcher, &payloadWriter, &contentLength, &downloaded, &contentWritten, &persistedAt, progressCallback, &lastProgress](std::size_t offset, const uint8_t* data, std::size_t length) -> bool {
+    if (offset != downloaded) {
+      if (offset != 0) {
+        OS_LOGE(TAG, "Unexpected download offset %zu, expected %zu", offset, downloaded);
+        return false;
+      }
+
+      // Server ignored the Range request and is sending the whole image again
+      OS_LOGW(TAG, "Server does not support resuming, restarting from the beginning");
+
+      if (!writer.flush() || !sha256.begin()) {
+        OS_LOGE(TAG, "Failed to restart partition download");
+        return false;
+      }
+
+      writer.reset(0);  // Erase-ahead starts over from the first sector as well
+      if (decoder != nullptr) {
+        decoder->reset();
+      }
+      if (patcher != nullptr) {
+        patcher->reset();
+      }
+
+      downloaded     = 0;
+      contentWritten = 0;
+      persistedAt    = 0;
+      OpenShock::Config::ClearOtaResumeState();
+    }
+
+    bool written = decoder != nullptr ? decoder->feed(data, length, payloadWriter) : payloadWriter(data, length);
+    if (!written) {
+      return false;
+    }
+
+    downloaded += length;
+
+    // Only checkpoint what the writer task has actually put on flash
+    std::size_t committed = writer.committed();
+    if (resumable && committed - persistedAt >= OTA_RESUME_PERSIST_INTERVAL) {
+      persistedAt = committed;
+      OpenShock::Config::SetOtaResumeState(partition->label, remoteUrl, remoteHash, committed);
+    }
+
     int64_t now = OpenShock::millis();
     if (now - lastProgress >= 500) {  // Send progress every 500ms
       lastProgress = now;
-      progressCallback(contentWritten, contentLength, static_cast<float>(contentWritten) / static_cast<float>(contentLength));
+      progressCallback(downloaded, contentLength, static_cast<float>(downloaded) / static_cast<float>(contentLength));
     }
 
     return true;
   };
 
-  // Start streaming binary to app partition.
-  auto appBinaryResponse = OpenShock::HTTP::Download(
-    remoteUrl,
-    {
-      {"Accept", "application/octet-stream"}
-  },
-    sizeValidator,
-    dataWriter,
-    std::array<uint16_t, 2> {200, 304},
-    180'000
-  );  // 3 minutes
-  if (appBinaryResponse.result != OpenShock::HTTP::RequestResult::Success) {
-    OS_LOGE(TAG, "Failed to download remote partition binary: [%u]", appBinaryResponse.code);
-    return false;
+  int64_t downloadBegin = OpenShock::millis();
+
+  // Start streaming binary to app partition, resuming with Range requests if the connection drops.
+  for (int attempt = 1;; ++attempt) {
+    auto appBinaryResponse = OpenShock::HTTP::Download(
+      remoteUrl,
+      {
+        {"Accept", "application/octet-stream"}
+    },
+      sizeValidator,
+      dataWriter,
+      std::array<uint16_t, 2> {200, 304},
+      180'000,  // 3 minutes
+      downloaded
+    );
+
+    // Drain the pipeline so flash, hash and cursor agree before deciding how to continue
+    if (!writer.flush()) {
+      OS_LOGE(TAG, "Failed to write to partition");
+      OpenShock::Config::ClearOtaResumeState();
+      return false;
+    }
+
+    if (appBinaryResponse.result == OpenShock::HTTP::RequestResult::Success && (contentLength == 0 || downloaded == contentLength)) {
+      if (decoder != nullptr && !decoder->done()) {
+        OS_LOGE(TAG, "Compressed partition binary ended before the end of the stream");
+        return false;
+      }
+      if (patcher != nullptr && !patcher->done()) {
+        OS_LOGE(TAG, "Partition patch ended before the end of the image");
+        return false;
+      }
+      break;
+    }
+
+    if (appBinaryResponse.result == OpenShock::HTTP::RequestResult::Cancelled) {
+      // Our own callbacks refused the data, resuming would only repeat the failure
+      OpenShock::Config::ClearOtaResumeState();
+      return false;
+    }
+
+    if (appBinaryResponse.code == 416) {  // Range Not Satisfiable
+      OS_LOGW(TAG, "Server rejected the resume offset, restarting from the beginning");
+      if (!sha256.begin()) {
+        OS_LOGE(TAG, "Failed to initialize SHA256 hash");
+        return false;
+      }
+      writer.reset(0);
+      if (decoder != nullptr) {
+        decoder->reset();
+      }
+      if (patcher != nullptr) {
+        patcher->reset();
+      }
+      downloaded     = 0;
+      contentWritten = 0;
+      persistedAt    = 0;
+      OpenShock::Config::ClearOtaResumeState();
+    } else if (resumable && contentWritten > persistedAt) {
+      persistedAt = contentWritten;
+      OpenShock::Config::SetOtaResumeState(partition->label, remoteUrl, remoteHash, contentWritten);
+    }
+
+    if (attempt >= OTA_DOWNLOAD_ATTEMPTS) {
+      OS_LOGE(TAG, "Failed to download remote partition binary: [%u], progress is kept for the next attempt", appBinaryResponse.code);
+      return false;
+    }
+
+    OS_LOGW(TAG, "Download interrupted at %zu / %zu bytes, resuming in %u ms", downloaded, contentLength, OTA_DOWNLOAD_RETRY_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(OTA_DOWNLOAD_RETRY_DELAY));
   }
 
+  OpenShock::Config::ClearOtaResumeState();
+
   progressCallback(contentLength, contentLength, 1.0f);
-  OS_LOGD(TAG, "Wrote %u bytes to partition", appBinaryResponse.data);
+
+  int64_t downloadMs = std::max<int64_t>(OpenShock::millis() - downloadBegin, 1);
+  OS_LOGI(TAG, "Wrote %zu bytes to partition in %lld ms (%llu KiB/s), first byte on flash after %lld ms", contentWritten - resumeOffset, downloadMs, (static_cast<uint64_t>(contentWritten - resumeOffset) * 1000 / downloadMs) / 1024, writer.firstCommitMs());
+  if (!resumable) {
+    OS_LOGI(TAG, "Decoded %zu downloaded bytes into %zu", downloaded, contentWritten);
+  }
 
   std::array<uint8_t, 32> localHash;
   if (!sha256.finish(localHash)) {
@@ -109,3 +347,268 @@ bool OpenShock::FlashPartitionFromUrl(const esp_partition_t* partition, std::str
 
   return true;
 }
+
+// Blocks past the end of the image are hashed as erased flash, which is what a full flash leaves there
+static bool tryHashPartitionBlock(const esp_partition_t* partition, std::size_t index, uint8_t* buffer, uint8_t (&hash)[32])
+{
+  if (esp_partition_read(partition, index * SPI_FLASH_SEC_SIZE, buffer, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+    OS_LOGE(TAG, "Failed to read partition block %zu", index);
+    return false;
+  }
+
+  OpenShock::SHA256 sha256;
+  std::array<uint8_t, 32> digest;
+  if (!sha256.begin() || !sha256.update(buffer, SPI_FLASH_SEC_SIZE) || !sha256.finish(digest)) {
+    OS_LOGE(TAG, "Failed to hash partition block %zu", index);
+    return false;
+  }
+
+  memcpy(hash, digest.data(), sizeof(hash));
+
+  return true;
+}
+
+// Block list layout: the image size on the first line, then the SHA-256 of every 4 KiB block (the last one padded with 0xFF) one per line
+static bool tryGetChangedBlocks(const esp_partition_t* partition, std::string_view blockHashes, uint8_t* buffer, std::size_t& imageSize, std::vector<ChangedBlock>& changed)
+{
+  auto lines = OpenShock::StringSplitNewLines(blockHashes);
+
+  std::size_t blockCount = 0;
+  bool gotSize           = false;
+  for (std::string_view line : lines) {
+    line = OpenShock::StringTrim(line);
+    if (line.empty()) {
+      continue;
+    }
+
+    if (!gotSize) {
+      if (!OpenShock::Convert::ToSizeT(line, imageSize) || imageSize == 0 || imageSize > partition->size) {
+        OS_LOGE(TAG, "Invalid image size in block list");
+        return false;
+      }
+      gotSize = true;
+      continue;
+    }
+
+    ChangedBlock block {.index = static_cast<uint32_t>(blockCount), .hash = {}};
+    if (line.size() != 64 || OpenShock::HexUtils::TryParseHex(line.data(), line.size(), block.hash, 32) != 32) {
+      OS_LOGE(TAG, "Invalid block hash: %.*s", line.size(), line.data());
+      return false;
+    }
+
+    if (++blockCount * SPI_FLASH_SEC_SIZE >= imageSize + SPI_FLASH_SEC_SIZE) {
+      OS_LOGE(TAG, "Block list has more blocks than the image");
+      return false;
+    }
+
+    uint8_t localHash[32];
+    if (!tryHashPartitionBlock(partition, block.index, buffer, localHash)) {
+      return false;
+    }
+
+    if (memcmp(localHash, block.hash, 32) != 0) {
+      changed.push_back(block);
+    }
+  }
+
+  if (!gotSize || blockCount * SPI_FLASH_SEC_SIZE < imageSize) {
+    OS_LOGE(TAG, "Block list does not cover the image");
+    return false;
+  }
+
+  return true;
+}
+
+bool OpenShock::FlashPartitionBlocksFromUrl(const esp_partition_t* partition, std::string_view remoteUrl, std::string_view blockHashesUrl, const uint8_t (&remoteHash)[32], std::function<bool(std::size_t, std::size_t, float)> progressCallback)
+{
+  auto blockHashesResponse = OpenShock::HTTP::GetString(
+    blockHashesUrl,
+    {
+      {"Accept", "text/plain"}
+  },
+    std::array<uint16_t, 2> {200, 304}
+  );
+  if (blockHashesResponse.result != OpenShock::HTTP::RequestResult::Success) {
+    OS_LOGE(TAG, "Failed to fetch block hashes: %s [%u]", blockHashesResponse.ResultToString(), blockHashesResponse.code);
+    return false;
+  }
+
+  uint8_t* buffer = static_cast<uint8_t*>(malloc(SPI_FLASH_SEC_SIZE));
+  if (buffer == nullptr) {
+    OS_LOGE(TAG, "Out of memory");
+    return false;
+  }
+
+  std::size_t imageSize = 0;
+  std::vector<ChangedBlock> changed;
+  if (!tryGetChangedBlocks(partition, blockHashesResponse.data, buffer, imageSize, changed)) {
+    free(buffer);
+    return false;
+  }
+
+  blockHashesResponse.data = {};  // Release the block list before downloading
+
+  // Join changed blocks into a few ranges, first across small gaps, then across the smallest gaps left until the request budget fits
+  std::vector<std::pair<std::size_t, std::size_t>> ranges;  // Indices into changed, inclusive
+  for (std::size_t i = 0; i < changed.size(); ++i) {
+    if (!ranges.empty() && changed[i].index - changed[ranges.back().second].index <= OTA_BLOCK_MERGE_GAP + 1) {
+      ranges.back().second = i;
+    } else {
+      ranges.emplace_back(i, i);
+    }
+  }
+  while (ranges.size() > OTA_BLOCK_MAX_RANGES) {
+    std::size_t best = 0;
+    for (std::size_t i = 1; i + 1 < ranges.size(); ++i) {
+      if (changed[ranges[i + 1].first].index - changed[ranges[i].second].index < changed[ranges[best + 1].first].index - changed[ranges[best].second].index) {
+        best = i;
+      }
+    }
+    ranges[best].second = ranges[best + 1].second;
+    ranges.erase(ranges.begin() + best + 1);
+  }
+
+  auto rangeBegin = [&changed](const std::pair<std::size_t, std::size_t>& range) -> std::size_t { return changed[range.first].index * SPI_FLASH_SEC_SIZE; };
+  auto rangeEnd   = [&changed, imageSize](const std::pair<std::size_t, std::size_t>& range) -> std::size_t { return std::min<std::size_t>((changed[range.second].index + 1) * SPI_FLASH_SEC_SIZE, imageSize); };
+
+  std::size_t totalFetch = 0;
+  for (const auto& range : ranges) {
+    totalFetch += rangeEnd(range) - rangeBegin(range);
+  }
+
+  OS_LOGI(TAG, "%zu of %zu blocks changed, fetching %zu bytes in %zu requests", changed.size(), (imageSize + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE, totalFetch, ranges.size());
+
+  std::size_t fetched     = 0;
+  std::size_t nextChanged = 0;  // Next entry in changed to be written
+  std::size_t cursor      = 0;  // Absolute offset of the next byte expected from the server
+  int64_t lastProgress    = 0;
+
+  auto sizeValidator = [imageSize](std::size_t size) -> bool {
+    if (size != imageSize) {
+      OS_LOGE(TAG, "Remote partition binary does not match the block list");
+      return false;
+    }
+    return true;
+  };
+  auto dataWriter = [partition, &changed, imageSize, buffer, &fetched, &nextChanged, &cursor, totalFetch, progressCallback, &lastProgress](std::size_t offset, const uint8_t* data, std::size_t length) -> bool {
+    if (offset != cursor) {
+      OS_LOGE(TAG, "Unexpected download offset %zu, expected %zu", offset, cursor);
+      return false;
+    }
+
+    while (length > 0) {
+      std::size_t blockStart = cursor - (cursor % SPI_FLASH_SEC_SIZE);
+      std::size_t blockEnd   = std::min<std::size_t>(blockStart + SPI_FLASH_SEC_SIZE, imageSize);
+      std::size_t n          = std::min(length, blockEnd - cursor);
+
+      memcpy(buffer + (cursor - blockStart), data, n);
+      cursor += n;
+      data += n;
+      length -= n;
+      fetched += n;
+
+      if (cursor < blockEnd) {
+        break;
+      }
+
+      // Blocks that only joined two ranges are already up to date
+      std::size_t index = blockStart / SPI_FLASH_SEC_SIZE;
+      if (nextChanged >= changed.size() || changed[nextChanged].index != index) {
+        continue;
+      }
+
+      memset(buffer + (blockEnd - blockStart), 0xFF, SPI_FLASH_SEC_SIZE - (blockEnd - blockStart));
+
+      OpenShock::SHA256 sha256;
+      std::array<uint8_t, 32> hash;
+      if (!sha256.begin() || !sha256.update(buffer, SPI_FLASH_SEC_SIZE) || !sha256.finish(hash) || memcmp(hash.data(), changed[nextChanged].hash, 32) != 0) {
+        OS_LOGE(TAG, "Downloaded block %zu does not match the block list", index);
+        return false;
+      }
+
+      if (esp_partition_erase_range(partition, blockStart, SPI_FLASH_SEC_SIZE) != ESP_OK || esp_partition_write(partition, blockStart, buffer, SPI_FLASH_SEC_SIZE) != ESP_OK) {
+        OS_LOGE(TAG, "Failed to write partition block %zu", index);
+        return false;
+      }
+
+      ++nextChanged;
+    }
+
+    int64_t now = OpenShock::millis();
+    if (now - lastProgress >= 500) {  // Send progress every 500ms
+      lastProgress = now;
+      progressCallback(fetched, totalFetch, static_cast<float>(fetched) / static_cast<float>(totalFetch));
+    }
+
+    return true;
+  };
+
+  int64_t downloadBegin = OpenShock::millis();
+
+  bool success = true;
+  for (const auto& range : ranges) {
+    cursor = rangeBegin(range);
+
+    for (int attempt = 1; cursor < rangeEnd(range); ++attempt) {
+      // A partially received block is dropped, so a retry starts at the block boundary
+      std::size_t retryFrom = cursor - (cursor % SPI_FLASH_SEC_SIZE);
+      fetched -= cursor - retryFrom;
+      cursor = retryFrom;
+
+      auto response = OpenShock::HTTP::Download(
+        remoteUrl,
+        {
+          {"Accept", "application/octet-stream"}
+      },
+        sizeValidator,
+        dataWriter,
+        std::array<uint16_t, 1> {206},  // Anything but a partial response means ranges are not supported
+        60'000,
+        cursor,
+        rangeEnd(range)
+      );
+
+      if (response.result == OpenShock::HTTP::RequestResult::Success && cursor == rangeEnd(range)) {
+        break;
+      }
+
+      if (response.result == OpenShock::HTTP::RequestResult::Cancelled || response.result == OpenShock::HTTP::RequestResult::CodeRejected || attempt >= OTA_DOWNLOAD_ATTEMPTS) {
+        OS_LOGE(TAG, "Failed to download partition blocks: %s [%u]", response.ResultToString(), response.code);
+        success = false;
+        break;
+      }
+
+      OS_LOGW(TAG, "Block download interrupted at %zu, retrying in %u ms", cursor, OTA_DOWNLOAD_RETRY_DELAY);
+      vTaskDelay(pdMS_TO_TICKS(OTA_DOWNLOAD_RETRY_DELAY));
+    }
+
+    if (!success) {
+      break;
+    }
+  }
+
+  free(buffer);
+
+  if (!success) {
+    return false;
+  }
+
+  progressCallback(totalFetch, totalFetch, 1.0f);
+
+  OS_LOGI(TAG, "Rewrote %zu blocks from %zu downloaded bytes in %lld ms", changed.size(), fetched, OpenShock::millis() - downloadBegin);
+
+  // The block list only says what changed, the image hash decides whether the result is right
+  OpenShock::SHA256 sha256;
+  std::array<uint8_t, 32> localHash;
+  if (!sha256.begin() || !tryHashPartitionPrefix(partition, imageSize, sha256) || !sha256.finish(localHash)) {
+    OS_LOGE(TAG, "Failed to hash partition");
+    return false;
+  }
+
+  if (memcmp(localHash.data(), remoteHash, 32) != 0) {
+    OS_LOGE(TAG, "Partition hash mismatch after block update");
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,278 @@
+#include "util/PartitionWriter.h"
+
+const char* const TAG = "PartitionWriter";
+
+#include "Core.h"
+#include "Logging.h"
+#include "util/FnProxy.h"
+#include "util/TaskUtils.h"
+
+#include <esp_spi_flash.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+const BaseType_t kTaskPriority   = 2;     // Above the OTA task, so buffers drain as soon as it blocks on the network
+const uint32_t kTaskStackSize    = 4096;  // Only calls esp_partition_write and the SHA-256 update
+const TickType_t kBufferWaitTime = pdMS_TO_TICKS(30'000);
+const uint8_t kStopIndex         = UINT8_MAX;
+
+using namespace OpenShock;
+
+static std::size_t alignDown(std::size_t value, std::size_t alignment)
+{
+  return value - (value % alignment);
+}
+
+static std::size_t alignUp(std::size_t value, std::size_t alignment)
+{
+  return alignDown(value + alignment - 1, alignment);
+}
+
+PartitionWriter::PartitionWriter(const esp_partition_t* partition, SHA256& sha256, std::size_t offset)
+  : m_partition(partition)
+  , m_sha256(sha256)
+  , m_buffers()
+  , m_freeQueue(nullptr)
+  , m_fullQueue(nullptr)
+  , m_taskHandle(nullptr)
+  , m_fillIndex(0)
+  , m_hasFill(false)
+  , m_fillOffset(offset)
+  , m_fillLength(0)
+  , m_erasedUntil(alignDown(offset, SPI_FLASH_SEC_SIZE))
+  , m_imageSize(partition->size)
+  , m_committed(offset)
+  , m_failed(false)
+  , m_createdAt(OpenShock::millis())
+  , m_firstCommitMs(-1)
+{
+  m_freeQueue = xQueueCreate(BUFFER_COUNT, sizeof(uint8_t));
+  m_fullQueue = xQueueCreate(BUFFER_COUNT + 1, sizeof(Block));  // +1 for the stop block
+  if (m_freeQueue == nullptr || m_fullQueue == nullptr) {
+    OS_LOGE(TAG, "Failed to create queues");
+    destroy();
+    return;
+  }
+
+  for (uint8_t i = 0; i < BUFFER_COUNT; ++i) {
+    m_buffers[i] = static_cast<uint8_t*>(malloc(BUFFER_SIZE));
+    if (m_buffers[i] == nullptr) {
+      OS_LOGE(TAG, "Out of memory");
+      destroy();
+      return;
+    }
+
+    xQueueSend(m_freeQueue, &i, 0);
+  }
+
+  if (TaskUtils::TaskCreateExpensive(Util::FnProxy<&PartitionWriter::WriterTask>, "PartitionWriter", kTaskStackSize, this, kTaskPriority, &m_taskHandle) != pdPASS) {
+    OS_LOGE(TAG, "Failed to create writer task");
+    destroy();
+    return;
+  }
+}
+
+PartitionWriter::~PartitionWriter()
+{
+  destroy();
+}
+
+bool PartitionWriter::write(std::size_t offset, const uint8_t* data, std::size_t length)
+{
+  if (!ok()) {
+    return false;
+  }
+
+  if (offset != m_fillOffset + m_fillLength) {
+    OS_LOGE(TAG, "Non-contiguous write at %zu, expected %zu", offset, m_fillOffset + m_fillLength);
+    return false;
+  }
+
+  while (length > 0) {
+    if (!m_hasFill && !acquireBuffer()) {
+      return false;
+    }
+
+    std::size_t n = std::min(length, BUFFER_SIZE - m_fillLength);
+    memcpy(m_buffers[m_fillIndex] + m_fillLength, data, n);
+
+    m_fillLength += n;
+    data += n;
+    length -= n;
+
+    if (m_fillLength == BUFFER_SIZE && !submitBuffer()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool PartitionWriter::flush()
+{
+  if (m_freeQueue == nullptr || m_fullQueue == nullptr || m_taskHandle == nullptr) {
+    return false;
+  }
+
+  if (m_hasFill) {
+    if (m_fillLength > 0) {
+      if (!submitBuffer()) {
+        return false;
+      }
+    } else {
+      xQueueSend(m_freeQueue, &m_fillIndex, 0);
+      m_hasFill = false;
+    }
+  }
+
+  // Once every buffer has been handed back, nothing is in flight
+  std::array<uint8_t, BUFFER_COUNT> indices;
+  std::size_t taken = 0;
+  while (taken < BUFFER_COUNT) {
+    if (xQueueReceive(m_freeQueue, &indices[taken], kBufferWaitTime) != pdTRUE) {
+      OS_LOGE(TAG, "Timed out waiting for writer task");
+      m_failed = true;
+      break;
+    }
+    ++taken;
+  }
+
+  for (std::size_t i = 0; i < taken; ++i) {
+    xQueueSend(m_freeQueue, &indices[i], 0);
+  }
+
+  return !m_failed;
+}
+
+void PartitionWriter::reset(std::size_t offset)
+{
+  m_fillOffset  = offset;
+  m_fillLength  = 0;
+  m_erasedUntil = alignDown(offset, SPI_FLASH_SEC_SIZE);
+  m_committed   = offset;
+}
+
+bool PartitionWriter::acquireBuffer()
+{
+  if (xQueueReceive(m_freeQueue, &m_fillIndex, kBufferWaitTime) != pdTRUE) {
+    OS_LOGE(TAG, "Timed out waiting for a free buffer");
+    m_failed = true;
+    return false;
+  }
+
+  if (m_failed) {
+    xQueueSend(m_freeQueue, &m_fillIndex, 0);
+    return false;
+  }
+
+  m_hasFill    = true;
+  m_fillLength = 0;
+
+  return true;
+}
+
+bool PartitionWriter::submitBuffer()
+{
+  Block block {.index = m_fillIndex, .offset = static_cast<uint32_t>(m_fillOffset), .length = static_cast<uint32_t>(m_fillLength)};
+
+  // Cannot block, there are never more blocks in flight than buffers
+  if (xQueueSend(m_fullQueue, &block, 0) != pdTRUE) {
+    OS_LOGE(TAG, "Failed to queue block");
+    m_failed = true;
+    return false;
+  }
+
+  m_fillOffset += m_fillLength;
+  m_fillLength = 0;
+  m_hasFill    = false;
+
+  return true;
+}
+
+bool PartitionWriter::eraseAhead(std::size_t end)
+{
+  if (end <= m_erasedUntil) {
+    return true;
+  }
+
+  // Erase a whole stride past the cursor at once, but never beyond the sectors the image needs
+  std::size_t limit  = std::min<std::size_t>(alignUp(m_imageSize, SPI_FLASH_SEC_SIZE), m_partition->size);
+  std::size_t target = std::min(alignUp(end, ERASE_AHEAD), limit);
+  if (target < end) {
+    target = std::min<std::size_t>(alignUp(end, SPI_FLASH_SEC_SIZE), m_partition->size);  // Image is larger than announced
+  }
+
+  esp_err_t err = esp_partition_erase_range(m_partition, m_erasedUntil, target - m_erasedUntil);
+  if (err != ESP_OK) {
+    OS_LOGE(TAG, "Failed to erase partition at %zu: %s", m_erasedUntil, esp_err_to_name(err));
+    return false;
+  }
+
+  m_erasedUntil = target;
+
+  return true;
+}
+
+void PartitionWriter::destroy()
+{
+  if (m_taskHandle != nullptr) {
+    Block stop {.index = kStopIndex, .offset = 0, .length = 0};
+    xQueueSend(m_fullQueue, &stop, portMAX_DELAY);
+
+    TaskUtils::StopTask(m_taskHandle, TAG, "PartitionWriter task", kBufferWaitTime);
+
+    m_taskHandle = nullptr;
+  }
+
+  if (m_fullQueue != nullptr) {
+    vQueueDelete(m_fullQueue);
+    m_fullQueue = nullptr;
+  }
+
+  if (m_freeQueue != nullptr) {
+    vQueueDelete(m_freeQueue);
+    m_freeQueue = nullptr;
+  }
+
+  for (auto& buffer : m_buffers) {
+    free(buffer);
+    buffer = nullptr;
+  }
+}
+
+void PartitionWriter::WriterTask()
+{
+  Block block;
+  while (xQueueReceive(m_fullQueue, &block, portMAX_DELAY) == pdTRUE) {
+    if (block.index == kStopIndex) {
+      break;
+    }
+
+    // After a failure, keep recycling buffers so the producer wakes up and sees the error
+    if (!m_failed) {
+      const uint8_t* data = m_buffers[block.index];
+
+      if (!eraseAhead(block.offset + block.length)) {
+        m_failed = true;
+      } else if (esp_partition_write(m_partition, block.offset, data, block.length) != ESP_OK) {
+        OS_LOGE(TAG, "Failed to write to partition at %u", block.offset);
+        m_failed = true;
+      } else if (!m_sha256.update(data, block.length)) {
+        OS_LOGE(TAG, "Failed to update SHA256 hash");
+        m_failed = true;
+      } else {
+        m_committed = block.offset + block.length;
+
+        if (m_firstCommitMs < 0) {
+          m_firstCommitMs = OpenShock::millis() - m_createdAt;
+        }
+      }
+    }
+
+    xQueueSend(m_freeQueue, &block.index, portMAX_DELAY);
+  }
+
+  vTaskDelete(nullptr);
+}